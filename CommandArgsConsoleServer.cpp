@@ -0,0 +1,364 @@
+#include "CommandArgsConsoleServer.h"
+#include <cstring>
+#include <cstdio>
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <errno.h>
+#endif //
+
+CommandArgsConsoleServer::CommandArgsConsoleServer(CommandArgsMgr & rMgr) : m_pMgr(&rMgr), m_ListenSocket(-1), m_EpollHandle(-1), m_MaxClients(0), m_NextClient(0) {
+
+}
+
+CommandArgsConsoleServer::~CommandArgsConsoleServer() {
+	Stop();
+}
+
+#if defined(__linux__)
+
+/// A connect that doesn't get refused means another server still owns the path
+static bool IsSocketPathInUse(const sockaddr_un & rAddress) {
+	const int probeSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (probeSocket < 0) {
+		return true;
+	}
+	const bool bInUse = connect(probeSocket, reinterpret_cast<const sockaddr *>(&rAddress), sizeof(rAddress)) == 0 || errno != ECONNREFUSED;
+	close(probeSocket);
+	return bInUse;
+}
+
+bool CommandArgsConsoleServer::Start(const char * pSocketPath, const uint32_t maxClients /*= 64*/) {
+	Stop();
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (!pSocketPath || !(*pSocketPath) || strlen(pSocketPath) >= sizeof(address.sun_path)) {
+		return false;
+	}
+	strcpy(address.sun_path, pSocketPath);
+	// A socket file left behind by a previous run would make bind fail, anything else at the path is left alone
+	struct stat pathStat;
+	if (lstat(pSocketPath, &pathStat) == 0) {
+		if (!S_ISSOCK(pathStat.st_mode) || IsSocketPathInUse(address)) {
+			return false;
+		}
+		unlink(pSocketPath);
+	} else if (errno != ENOENT) {
+		return false;
+	}
+	m_ListenSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (m_ListenSocket < 0) {
+		return false;
+	}
+	if (bind(m_ListenSocket, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0) {
+		Stop();
+		return false;
+	}
+	m_SocketPath = pSocketPath;
+	// Clients can run any command so only the owner may connect
+	// Nobody can connect before listen() so there's no window with the default permissions
+	m_EpollHandle = epoll_create1(EPOLL_CLOEXEC);
+	epoll_event listenEvent;
+	memset(&listenEvent, 0, sizeof(listenEvent));
+	listenEvent.events = EPOLLIN;
+	listenEvent.data.ptr = nullptr;
+	if (chmod(pSocketPath, S_IRUSR | S_IWUSR) != 0 || listen(m_ListenSocket, SOMAXCONN) != 0 || m_EpollHandle < 0 ||
+		epoll_ctl(m_EpollHandle, EPOLL_CTL_ADD, m_ListenSocket, &listenEvent) != 0) {
+		Stop();
+		return false;
+	}
+	m_MaxClients = maxClients;
+	return true;
+}
+
+void CommandArgsConsoleServer::Stop() {
+	for (size_t i = 0; i < m_Clients.size(); ++i) {
+		close(m_Clients[i]->m_Socket);
+	}
+	m_Clients.clear();
+	if (m_EpollHandle >= 0) {
+		close(m_EpollHandle);
+		m_EpollHandle = -1;
+	}
+	if (m_ListenSocket >= 0) {
+		close(m_ListenSocket);
+		m_ListenSocket = -1;
+	}
+	// Only set once bind created the socket file
+	if (!m_SocketPath.empty()) {
+		unlink(m_SocketPath.c_str());
+		m_SocketPath.clear();
+	}
+	m_NextClient = 0;
+}
+
+uint32_t CommandArgsConsoleServer::Poll(const uint32_t maxCommands /*= 0*/, const int timeoutMilliseconds /*= 0*/) {
+	if (!IsRunning()) {
+		return 0;
+	}
+	bool bHasPendingLines = false;
+	for (size_t i = 0; i < m_Clients.size(); ++i) {
+		bHasPendingLines |= m_Clients[i]->m_bHasPendingLines;
+	}
+	// One wait covers every client, then everything that arrived is executed as one batch
+	epoll_event events[64];
+	const int numEvents = epoll_wait(m_EpollHandle, events, sizeof(events) / sizeof(events[0]), bHasPendingLines ? 0 : timeoutMilliseconds);
+	for (int e = 0; e < numEvents; ++e) {
+		ConsoleClient * pClient = static_cast<ConsoleClient *>(events[e].data.ptr);
+		if (pClient == nullptr) {
+			AcceptClients();
+			continue;
+		}
+		if (events[e].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+			ReadFromClient(*pClient);
+		}
+		if ((events[e].events & (EPOLLHUP | EPOLLERR)) && pClient->m_bReadClosed && !pClient->m_bHungUp) {
+			// Nobody is left to read replies, run what was received and close
+			pClient->m_bHungUp = true;
+			pClient->m_Replies.clear();
+			pClient->m_RepliesSent = 0;
+		}
+		if ((events[e].events & EPOLLOUT) && !pClient->m_bClosed) {
+			FlushReplies(*pClient);
+		}
+	}
+	uint32_t numExecuted = 0;
+	const size_t numClients = m_Clients.size();
+	for (size_t c = 0; c < numClients; ++c) {
+		ConsoleClient & rClient = *m_Clients[(m_NextClient + c) % numClients];
+		if (maxCommands != 0 && numExecuted >= maxCommands) {
+			// Out of budget, make sure the next Poll() doesn't wait on these
+			rClient.m_bHasPendingLines = rClient.m_ReadStart < rClient.m_ReadEnd;
+			continue;
+		}
+		numExecuted += ExecuteClientLines(rClient, (maxCommands != 0) ? maxCommands - numExecuted : 0);
+	}
+	m_NextClient = (numClients > 0) ? (m_NextClient + 1) % numClients : 0;
+	for (size_t c = 0; c < numClients; ++c) {
+		ConsoleClient & rClient = *m_Clients[c];
+		if (!rClient.m_bClosed && rClient.m_RepliesSent < rClient.m_Replies.size()) {
+			FlushReplies(rClient);
+		}
+	}
+	RemoveClosedClients();
+	return numExecuted;
+}
+
+void CommandArgsConsoleServer::AcceptClients() {
+	for (;;) {
+		const int clientSocket = accept4(m_ListenSocket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (clientSocket < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return;
+		}
+		if (m_Clients.size() >= m_MaxClients) {
+			close(clientSocket);
+			continue;
+		}
+		std::unique_ptr<ConsoleClient> pClient(new ConsoleClient());
+		pClient->m_Socket = clientSocket;
+		pClient->m_ReadBufferSize = 4096;
+		pClient->m_pReadBuffer.reset(new char[pClient->m_ReadBufferSize]);
+		pClient->m_ReadStart = pClient->m_ReadEnd = 0;
+		pClient->m_RepliesSent = 0;
+		pClient->m_bHasPendingLines = pClient->m_bWantsWrite = pClient->m_bReadClosed = pClient->m_bHungUp = pClient->m_bClosed = false;
+		pClient->m_bWantsRead = true;
+		epoll_event clientEvent;
+		memset(&clientEvent, 0, sizeof(clientEvent));
+		clientEvent.events = EPOLLIN;
+		clientEvent.data.ptr = pClient.get();
+		if (epoll_ctl(m_EpollHandle, EPOLL_CTL_ADD, clientSocket, &clientEvent) != 0) {
+			close(clientSocket);
+			continue;
+		}
+		m_Clients.push_back(std::move(pClient));
+	}
+}
+
+void CommandArgsConsoleServer::ReadFromClient(ConsoleClient & rClient) {
+	while (!rClient.m_bReadClosed && !rClient.m_bClosed) {
+		// The last byte stays free to terminate a final line sent without a newline
+		if (rClient.m_ReadEnd + 1 >= rClient.m_ReadBufferSize) {
+			char * pBuffer = rClient.m_pReadBuffer.get();
+			const size_t numUnexecuted = rClient.m_ReadEnd - rClient.m_ReadStart;
+			if (memchr(pBuffer + rClient.m_ReadStart, '\n', numUnexecuted) != nullptr) {
+				// Full of lines the budget hasn't reached yet, read more once they've run
+				UpdateReadInterest(rClient);
+				return;
+			}
+			if (rClient.m_ReadStart > 0) {
+				// Only the partial line at the end is ever moved
+				memmove(pBuffer, pBuffer + rClient.m_ReadStart, numUnexecuted);
+				rClient.m_ReadStart = 0;
+				rClient.m_ReadEnd = numUnexecuted;
+			} else if (rClient.m_ReadBufferSize < ms_MaxLineLength) {
+				const size_t newBufferSize = (rClient.m_ReadBufferSize * 2 < ms_MaxLineLength) ? rClient.m_ReadBufferSize * 2 : ms_MaxLineLength;
+				std::unique_ptr<char[]> pNewBuffer(new char[newBufferSize]);
+				memcpy(pNewBuffer.get(), pBuffer, numUnexecuted);
+				rClient.m_pReadBuffer = std::move(pNewBuffer);
+				rClient.m_ReadBufferSize = newBufferSize;
+			} else {
+				rClient.m_bClosed = true;
+				return;
+			}
+		}
+		const ssize_t numReceived = recv(rClient.m_Socket, rClient.m_pReadBuffer.get() + rClient.m_ReadEnd, rClient.m_ReadBufferSize - 1 - rClient.m_ReadEnd, 0);
+		if (numReceived > 0) {
+			rClient.m_ReadEnd += static_cast<size_t>(numReceived);
+		} else if (numReceived == 0) {
+			rClient.m_bReadClosed = true;
+			UpdateClientEvents(rClient);
+		} else if (errno == EINTR) {
+			continue;
+		} else {
+			if (errno != EAGAIN && errno != EWOULDBLOCK) {
+				rClient.m_bClosed = true;
+			}
+			return;
+		}
+	}
+}
+
+uint32_t CommandArgsConsoleServer::ExecuteClientLines(ConsoleClient & rClient, const uint32_t maxCommands) {
+	rClient.m_bHasPendingLines = false;
+	if (rClient.m_bClosed) {
+		return 0;
+	}
+	char * pBuffer = rClient.m_pReadBuffer.get();
+	uint32_t numExecuted = 0;
+	while (rClient.m_ReadStart < rClient.m_ReadEnd) {
+		char * pLine = pBuffer + rClient.m_ReadStart;
+		char * pLineEnd = static_cast<char *>(memchr(pLine, '\n', rClient.m_ReadEnd - rClient.m_ReadStart));
+		if (!pLineEnd) {
+			if (!rClient.m_bReadClosed) {
+				break;
+			}
+			// The client shut down after a last line without a newline, it still runs
+			pLineEnd = pBuffer + rClient.m_ReadEnd;
+		}
+		if (!rClient.m_bHungUp && rClient.m_Replies.size() - rClient.m_RepliesSent >= ms_MaxPendingReplyBytes) {
+			// Picked up again once EPOLLOUT says the client is reading
+			break;
+		}
+		if (maxCommands != 0 && numExecuted >= maxCommands) {
+			rClient.m_bHasPendingLines = true;
+			break;
+		}
+		// Terminate in place, the command runs straight from the receive buffer
+		*pLineEnd = '\0';
+		if (pLineEnd > pLine && pLineEnd[-1] == '\r') {
+			pLineEnd[-1] = '\0';
+		}
+		rClient.m_ReadStart = (pLineEnd < pBuffer + rClient.m_ReadEnd) ? static_cast<size_t>(pLineEnd + 1 - pBuffer) : rClient.m_ReadEnd;
+		const int result = m_pMgr->Execute(pLine);
+		if (!rClient.m_bHungUp) {
+			char reply[16];
+			const int replyLen = snprintf(reply, sizeof(reply), "%d\n", result);
+			rClient.m_Replies.insert(rClient.m_Replies.end(), reply, reply + replyLen);
+		}
+		++numExecuted;
+	}
+	if (rClient.m_ReadStart == rClient.m_ReadEnd) {
+		rClient.m_ReadStart = rClient.m_ReadEnd = 0;
+	}
+	if (rClient.m_bReadClosed && rClient.m_ReadStart == rClient.m_ReadEnd && rClient.m_RepliesSent == rClient.m_Replies.size()) {
+		rClient.m_bClosed = true;
+	}
+	UpdateReadInterest(rClient);
+	return numExecuted;
+}
+
+void CommandArgsConsoleServer::FlushReplies(ConsoleClient & rClient) {
+	while (rClient.m_RepliesSent < rClient.m_Replies.size()) {
+		const ssize_t numSent = send(rClient.m_Socket, &rClient.m_Replies[rClient.m_RepliesSent], rClient.m_Replies.size() - rClient.m_RepliesSent, MSG_NOSIGNAL);
+		if (numSent > 0) {
+			rClient.m_RepliesSent += static_cast<size_t>(numSent);
+		} else if (numSent < 0 && errno == EINTR) {
+			continue;
+		} else if (numSent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			if (!rClient.m_bWantsWrite) {
+				rClient.m_bWantsWrite = true;
+				UpdateClientEvents(rClient);
+			}
+			UpdateReadInterest(rClient);
+			return;
+		} else {
+			rClient.m_bClosed = true;
+			return;
+		}
+	}
+	rClient.m_Replies.clear();
+	rClient.m_RepliesSent = 0;
+	if (rClient.m_bWantsWrite) {
+		rClient.m_bWantsWrite = false;
+		UpdateClientEvents(rClient);
+	}
+	if (rClient.m_bReadClosed && rClient.m_ReadStart == rClient.m_ReadEnd) {
+		rClient.m_bClosed = true;
+	}
+	UpdateReadInterest(rClient);
+}
+
+void CommandArgsConsoleServer::UpdateClientEvents(ConsoleClient & rClient) {
+	epoll_event clientEvent;
+	memset(&clientEvent, 0, sizeof(clientEvent));
+	clientEvent.events = 0;
+	if (rClient.m_bWantsRead && !rClient.m_bReadClosed) {
+		clientEvent.events |= EPOLLIN;
+	}
+	if (rClient.m_bWantsWrite) {
+		clientEvent.events |= EPOLLOUT;
+	}
+	clientEvent.data.ptr = &rClient;
+	epoll_ctl(m_EpollHandle, EPOLL_CTL_MOD, rClient.m_Socket, &clientEvent);
+}
+
+void CommandArgsConsoleServer::UpdateReadInterest(ConsoleClient & rClient) {
+	if (rClient.m_bClosed || rClient.m_bReadClosed) {
+		return;
+	}
+	// Level triggered EPOLLIN keeps firing while the client is paused, so only ask for it when data would be read
+	const bool bRepliesBacklogged = rClient.m_Replies.size() - rClient.m_RepliesSent >= ms_MaxPendingReplyBytes;
+	const bool bBufferFullOfLines = rClient.m_ReadEnd + 1 >= rClient.m_ReadBufferSize &&
+		memchr(rClient.m_pReadBuffer.get() + rClient.m_ReadStart, '\n', rClient.m_ReadEnd - rClient.m_ReadStart) != nullptr;
+	const bool bWantsRead = !bRepliesBacklogged && !bBufferFullOfLines;
+	if (bWantsRead != rClient.m_bWantsRead) {
+		rClient.m_bWantsRead = bWantsRead;
+		UpdateClientEvents(rClient);
+	}
+}
+
+void CommandArgsConsoleServer::RemoveClosedClients() {
+	for (size_t i = 0; i < m_Clients.size();) {
+		if (m_Clients[i]->m_bClosed) {
+			// Closing the socket also removes it from the epoll set
+			close(m_Clients[i]->m_Socket);
+			m_Clients[i] = std::move(m_Clients.back());
+			m_Clients.pop_back();
+		} else {
+			++i;
+		}
+	}
+}
+
+#else
+
+bool CommandArgsConsoleServer::Start(const char * pSocketPath, const uint32_t maxClients /*= 64*/) {
+	return false;
+}
+
+void CommandArgsConsoleServer::Stop() {
+
+}
+
+uint32_t CommandArgsConsoleServer::Poll(const uint32_t maxCommands /*= 0*/, const int timeoutMilliseconds /*= 0*/) {
+	return 0;
+}
+
+#endif //
@@ -0,0 +1,72 @@
+#ifndef COMMAND_ARGS_CONSOLE_SERVER_H
+#define COMMAND_ARGS_CONSOLE_SERVER_H
+
+#include "CommandArgsParser.h"
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+
+/// Optional console for a running process, clients connect to a Unix domain socket
+/// Every line a client sends is one command and gets one reply line holding the int Execute() returned
+/// Nothing happens on other threads: Poll() accepts, reads, executes and replies so the
+/// thread calling it decides when commands run
+/// Only available on Linux (epoll), Start() fails everywhere else
+class CommandArgsConsoleServer {
+public:
+
+	explicit CommandArgsConsoleServer(CommandArgsMgr & rMgr);
+	~CommandArgsConsoleServer();
+	CommandArgsConsoleServer(const CommandArgsConsoleServer &) = delete;
+	CommandArgsConsoleServer & operator=(const CommandArgsConsoleServer &) = delete;
+
+	/// Fails if something other than a socket left behind by a previous run exists at pSocketPath
+	/// The socket only accepts connections from the owning user
+	bool Start(const char * pSocketPath, const uint32_t maxClients = 64);
+	void Stop();
+	/// Executes up to maxCommands complete lines across all clients, 0 means no limit
+	/// Only waits for input when no lines are left over from the previous call
+	/// Returns the number of commands executed
+	uint32_t Poll(const uint32_t maxCommands = 0, const int timeoutMilliseconds = 0);
+	bool IsRunning() const { return m_ListenSocket >= 0; }
+	size_t GetNumClients() const { return m_Clients.size(); }
+
+	static const size_t ms_MaxLineLength = 64 * 1024;	// Clients sending longer lines are disconnected
+	static const size_t ms_MaxPendingReplyBytes = 1024 * 1024;	// Stop executing for a client that isn't reading replies
+
+private:
+	/// Lines are read straight into m_ReadBuffer and executed in place
+	struct ConsoleClient {
+		int m_Socket;
+		std::unique_ptr<char[]> m_pReadBuffer;
+		size_t m_ReadBufferSize;
+		size_t m_ReadStart;		// First byte not executed yet
+		size_t m_ReadEnd;		// One past the last byte received
+		std::vector<char> m_Replies;
+		size_t m_RepliesSent;
+		bool m_bHasPendingLines;	// Complete lines left over by the Poll() budget or a full reply buffer
+		bool m_bWantsRead;		// Registered for EPOLLIN, dropped while paused since unread data would wake every Poll()
+		bool m_bWantsWrite;		// Registered for EPOLLOUT
+		bool m_bReadClosed;		// Client shut down its side, close once the replies are sent
+		bool m_bHungUp;			// Client is gone entirely, remaining lines run without replies
+		bool m_bClosed;
+	};
+
+	void AcceptClients();
+	void ReadFromClient(ConsoleClient & rClient);
+	uint32_t ExecuteClientLines(ConsoleClient & rClient, const uint32_t maxCommands);
+	void FlushReplies(ConsoleClient & rClient);
+	void UpdateClientEvents(ConsoleClient & rClient);
+	void UpdateReadInterest(ConsoleClient & rClient);
+	void RemoveClosedClients();
+
+	CommandArgsMgr * m_pMgr;
+	std::vector<std::unique_ptr<ConsoleClient>> m_Clients;
+	std::string m_SocketPath;
+	int m_ListenSocket;
+	int m_EpollHandle;
+	uint32_t m_MaxClients;
+	size_t m_NextClient;	// Round robin start so a busy client can't starve the others
+};
+
+#endif // COMMAND_ARGS_CONSOLE_SERVER_H
@@ -1,73 +1,89 @@
 #include "CommandArgsParser.h"
 #include <fstream>
-#include <string>
 #include <cassert>
+#include <utility>
+#include <thread>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <chrono>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif //
 
-CommandArgVariable::CommandArgVariable(const char * pVariableName, const CommandArgVariableType::Type nType, const int defaultIntValue, const uint8_t flags) : m_Flags(flags) {
-	assert(nType == CommandArgVariableType::Integer);
-	memset(&m_Data, 0, sizeof(m_Data));
-	CommandArgsMgr::GetInstance().RegisterCommandArgVariableByName(pVariableName, this);
-	m_Type = nType;
-	m_Data.m_AsInt = defaultIntValue;
-}
+#if defined(_WIN32)
+#include <stdlib.h>
+#define COMMAND_ARGS_ENVIRONMENT _environ
+#else
+extern char ** environ;
+#define COMMAND_ARGS_ENVIRONMENT environ
+#endif //
 
-CommandArgVariable::CommandArgVariable(const char * pVariableName, const CommandArgVariableType::Type nType, const bool defaultBoolValue, const uint8_t flags) : m_Flags(flags) {
-	assert(nType == CommandArgVariableType::Boolean);
-	memset(&m_Data, 0, sizeof(m_Data));
-	CommandArgsMgr::GetInstance().RegisterCommandArgVariableByName(pVariableName, this);
-	m_Type = nType;
-	m_Data.m_AsBool = defaultBoolValue;
-}
+// Token classification works on 64 byte blocks, SSE2 builds the masks 16 bytes at a time
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define COMMAND_ARGS_PARSER_USE_SSE2 (1)
+#include <emmintrin.h>
+#else
+#define COMMAND_ARGS_PARSER_USE_SSE2 (0)
+#endif //
 
-CommandArgVariable::CommandArgVariable(const char * pVariableName, const CommandArgVariableType::Type nType, const float defaultFloatValue, const uint8_t flags) : m_Flags(flags) {
-	assert(nType == CommandArgVariableType::Float);
-	memset(&m_Data, 0, sizeof(m_Data));
-	CommandArgsMgr::GetInstance().RegisterCommandArgVariableByName(pVariableName, this);
-	m_Type = nType;
-	m_Data.m_AsFloat = defaultFloatValue;
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#define COMMAND_ARGS_PREFETCH(ptr) _mm_prefetch(reinterpret_cast<const char *>(ptr), _MM_HINT_T0)
+#elif defined(__GNUC__) || defined(__clang__)
+#define COMMAND_ARGS_PREFETCH(ptr) __builtin_prefetch(ptr)
+#else
+#define COMMAND_ARGS_PREFETCH(ptr)
+#endif //
+
+#if defined(__PCLMUL__) && defined(__x86_64__)
+#define COMMAND_ARGS_PARSER_USE_PCLMUL (1)
+#include <wmmintrin.h>
+#else
+#define COMMAND_ARGS_PARSER_USE_PCLMUL (0)
+#endif //
+
+static inline uint32_t CountTrailingZeros64(const uint64_t value) {
+#if defined(_MSC_VER)
+	unsigned long index = 0;
+	_BitScanForward64(&index, value);
+	return static_cast<uint32_t>(index);
+#else
+	return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif //
 }
 
-CommandArgVariable::CommandArgVariable(const char * pVariableName, const CommandArgVariableType::Type nType, const char * defaultCStringValue, const uint8_t flags) : m_Flags(flags) {
-	assert(nType == CommandArgVariableType::CString);
+CommandArgValue::CommandArgValue() : m_Type(CommandArgVariableType::None), m_Flags(0), m_LazyState(CommandArgValueLazyState::Resolved) {
 	memset(&m_Data, 0, sizeof(m_Data));
-	CommandArgsMgr::GetInstance().RegisterCommandArgVariableByName(pVariableName, this);
-	m_Type = nType;
-	m_Data.m_AsCString = defaultCStringValue;
 }
 
-CommandArgVariable::CommandArgVariable(const uint32_t variableHash, const CommandArgVariableType::Type nType, const int defaultIntValue, const uint8_t flags /*= 0*/) : m_Flags(flags) {
-	assert(nType == CommandArgVariableType::Integer);
+CommandArgValue::CommandArgValue(const CommandArgVariableType::Type nType, const uint8_t flags /*= 0*/) : m_Type(nType), m_Flags(flags), m_LazyState(CommandArgValueLazyState::Resolved) {
 	memset(&m_Data, 0, sizeof(m_Data));
-	CommandArgsMgr::GetInstance().RegisterCommandArgVariableByHash(variableHash, this);
-	m_Type = nType;
-	m_Data.m_AsInt = defaultIntValue;
 }
 
-CommandArgVariable::CommandArgVariable(const uint32_t variableHash, const CommandArgVariableType::Type nType, const bool defaultBoolValue, const uint8_t flags) : m_Flags(flags) {
-	assert(nType == CommandArgVariableType::Boolean);
-	memset(&m_Data, 0, sizeof(m_Data));
-	CommandArgsMgr::GetInstance().RegisterCommandArgVariableByHash(variableHash, this);
-	m_Type = nType;
-	m_Data.m_AsBool = defaultBoolValue;
+CommandArgValue::CommandArgValue(CommandArgValue && rOther) : m_Data(rOther.m_Data), m_Type(rOther.m_Type), m_Flags(rOther.m_Flags), m_LazyState(rOther.m_LazyState.load()) {
+	// Ownership of the cstring (if any) moves with the data
+	rOther.m_Flags &= ~CommandArgVariableFlags::OwnsCString;
 }
 
-CommandArgVariable::CommandArgVariable(const uint32_t variableHash, const CommandArgVariableType::Type nType, const float defaultFloatValue, const uint8_t flags) : m_Flags(flags) {
-	assert(nType == CommandArgVariableType::Float);
-	memset(&m_Data, 0, sizeof(m_Data));
-	CommandArgsMgr::GetInstance().RegisterCommandArgVariableByHash(variableHash, this);
-	m_Type = nType;
-	m_Data.m_AsFloat = defaultFloatValue;
+CommandArgValue::~CommandArgValue() {
+	ReleaseCString();
 }
 
-CommandArgVariable::CommandArgVariable(const uint32_t variableHash, const CommandArgVariableType::Type nType, const char * defaultCStringValue, const uint8_t flags) : m_Flags(flags) {
-	assert(nType == CommandArgVariableType::CString);
-	memset(&m_Data, 0, sizeof(m_Data));
-	CommandArgsMgr::GetInstance().RegisterCommandArgVariableByHash(variableHash, this);
-	m_Type = nType;
-	m_Data.m_AsCString = defaultCStringValue;
+CommandArgValue & CommandArgValue::operator=(CommandArgValue && rOther) {
+	if (this != &rOther) {
+		ReleaseCString();
+		m_Data = rOther.m_Data;
+		m_Type = rOther.m_Type;
+		m_Flags = rOther.m_Flags;
+		m_LazyState.store(rOther.m_LazyState.load());
+		rOther.m_Flags &= ~CommandArgVariableFlags::OwnsCString;
+	}
+	return *this;
 }
 
-CommandArgVariable::~CommandArgVariable() {
+void CommandArgValue::ReleaseCString() {
 	if (m_Type == CommandArgVariableType::CString) {
 		if (m_Data.m_AsCString != nullptr) {
 			if (m_Flags & CommandArgVariableFlags::OwnsCString) {
@@ -78,68 +94,332 @@ CommandArgVariable::~CommandArgVariable() {
 	}
 }
 
-int CommandArgVariable::GetInt() const {
+void CommandArgValue::CancelLazyValue() {
+	// The raw text is never owned so just forget about it
+	if (m_LazyState.load(std::memory_order_relaxed) != CommandArgValueLazyState::Resolved) {
+		memset(&m_Data, 0, sizeof(m_Data));
+		m_LazyState.store(CommandArgValueLazyState::Resolved, std::memory_order_relaxed);
+	}
+}
+
+void CommandArgValue::ResolveLazyValue() const {
+	uint8_t expectedState = CommandArgValueLazyState::Pending;
+	if (m_LazyState.compare_exchange_strong(expectedState, CommandArgValueLazyState::Resolving, std::memory_order_acquire)) {
+		CommandArgValue parsedValue(GetType());
+		parsedValue.ParseFromString(m_Data.m_AsCString);
+		// Take over the parsed data, including ownership of a copied cstring
+		const uint8_t storageFlags = CommandArgVariableFlags::OwnsCString | CommandArgVariableFlags::InlineCString;
+		m_Data = parsedValue.m_Data;
+		m_Flags = (m_Flags & ~storageFlags) | (parsedValue.m_Flags & storageFlags);
+		parsedValue.m_Flags &= ~CommandArgVariableFlags::OwnsCString;
+		m_LazyState.store(CommandArgValueLazyState::Resolved, std::memory_order_release);
+	} else {
+		// Lost the race, wait for the winner to publish the value
+		while (m_LazyState.load(std::memory_order_acquire) != CommandArgValueLazyState::Resolved) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+void CommandArgValue::SetLazyValue(const char * pRawString) {
+	if (m_Type == CommandArgVariableType::None || pRawString == nullptr) {
+		return;
+	}
+	CancelLazyValue();
+	ReleaseCString();
+	m_Flags &= ~(CommandArgVariableFlags::OwnsCString | CommandArgVariableFlags::InlineCString);
+	m_Data.m_AsCString = pRawString;
+	m_LazyState.store(CommandArgValueLazyState::Pending, std::memory_order_release);
+}
+
+bool CommandArgValue::ParseFromString(const char * pString) {
+	CancelLazyValue();
+	if (m_Type == CommandArgVariableType::CString) {
+		// The whole rest of the line without quotes or a trailing comment
+		// Unquote on the stack when possible so short results can be stored inline
+		const size_t stringSize = strlen(pString) + 1;
+		char stackString[256];
+		if (stringSize <= sizeof(stackString)) {
+			const size_t unquotedLen = CommandArgsParser::UnquoteArgs(pString, stackString, sizeof(stackString), false);
+			StoreCStringCopy(stackString, unquotedLen);
+			return true;
+		}
+		char * pUnquotedString = new char[stringSize];
+		CommandArgsParser::UnquoteArgs(pString, pUnquotedString, stringSize, false);
+		SetCString(pUnquotedString);
+		m_Flags |= CommandArgVariableFlags::OwnsCString;
+		return true;
+	}
+	// Numbers and bools only ever look at the first token
+	char valueToken[64];
+	CommandArgsParser::UnquoteArgs(pString, valueToken, sizeof(valueToken), true);
+	if (m_Type == CommandArgVariableType::Boolean) {
+		bool boolToSet = false;
+		if (!CommandArgsParser::Parse_Bool(valueToken, boolToSet)) {
+			return false;
+		}
+		SetBool(boolToSet);
+		return true;
+	} else if (m_Type == CommandArgVariableType::Integer) {
+		int intToSet = 0;
+		if (!CommandArgsParser::Parse_Integer(valueToken, intToSet)) {
+			return false;
+		}
+		SetInt(intToSet);
+		return true;
+	} else if (m_Type == CommandArgVariableType::Float) {
+		float floatToSet = 0.0f;
+		if (!CommandArgsParser::Parse_Float(valueToken, floatToSet)) {
+			return false;
+		}
+		SetFloat(floatToSet);
+		return true;
+	}
+	return false;
+}
+
+int CommandArgValue::GetInt() const {
 	if (m_Type == CommandArgVariableType::Integer) {
+		if (IsLazyPending()) {
+			ResolveLazyValue();
+		}
 		return m_Data.m_AsInt;
 	}
 	return 0;
 }
 
-float CommandArgVariable::GetFloat() const {
+float CommandArgValue::GetFloat() const {
 	if (m_Type == CommandArgVariableType::Float) {
+		if (IsLazyPending()) {
+			ResolveLazyValue();
+		}
 		return m_Data.m_AsFloat;
 	}
 	return 0.0f;
 }
 
-bool CommandArgVariable::GetBool() const {
+bool CommandArgValue::GetBool() const {
 	if (m_Type == CommandArgVariableType::Boolean) {
+		if (IsLazyPending()) {
+			ResolveLazyValue();
+		}
 		return m_Data.m_AsBool;
 	}
 	return false;
 }
 
-const char * CommandArgVariable::GetCString() const {
+const char * CommandArgValue::GetCString() const {
 	if (m_Type == CommandArgVariableType::CString) {
-		return m_Data.m_AsCString;
+		if (IsLazyPending()) {
+			ResolveLazyValue();
+		}
+		return GetCStringPtr();
 	}
 	return "\0"; // maybe should be nullptr?
 }
 
-void CommandArgVariable::SetInt(const int i) {
+void CommandArgValue::SetInt(const int i) {
 	if (m_Type == CommandArgVariableType::Integer) {
+		CancelLazyValue();
 		m_Data.m_AsInt = i;
 	}
 }
 
-void CommandArgVariable::SetFloat(const float f) {
+void CommandArgValue::SetFloat(const float f) {
 	if (m_Type == CommandArgVariableType::Float) {
+		CancelLazyValue();
 		m_Data.m_AsFloat = f;
 	}
 }
 
-void CommandArgVariable::SetBool(const bool b) {
+void CommandArgValue::SetBool(const bool b) {
 	if (m_Type == CommandArgVariableType::Boolean) {
+		CancelLazyValue();
 		m_Data.m_AsBool = b;
 	}
 }
 
-void CommandArgVariable::SetCString(const char * pString) {
+void CommandArgValue::SetCString(const char * pString) {
 	if (m_Type == CommandArgVariableType::CString) {
+		CancelLazyValue();
 		// It's possible we set this c-string multiple times
 		// If it's owned we need to be careful to delete the old one
 		// The calling code is responsible for setting OwnsCString flag 
 		// which should probably only be done in the Execute function
+		if (pString == m_Data.m_AsInlineCString && (m_Flags & CommandArgVariableFlags::InlineCString)) {
+			return;
+		}
 		const char * pCurCString = GetCString();
 		if (pCurCString != nullptr) {
 			if (m_Flags & CommandArgVariableFlags::OwnsCString) {
 				delete[] pCurCString;
 			}
 		}
+		m_Flags &= ~(CommandArgVariableFlags::OwnsCString | CommandArgVariableFlags::InlineCString);
 		m_Data.m_AsCString = pString;
 	}
 }
 
+bool CommandArgValue::Equals(const CommandArgValue & rOther) const {
+	// Unparsed values are treated as different rather than parsing them early
+	if (m_Type != rOther.m_Type || IsLazyPending() || rOther.IsLazyPending()) {
+		return false;
+	}
+	switch (m_Type) {
+	case CommandArgVariableType::Integer:
+		return m_Data.m_AsInt == rOther.m_Data.m_AsInt;
+	case CommandArgVariableType::Float:
+		return m_Data.m_AsFloat == rOther.m_Data.m_AsFloat;
+	case CommandArgVariableType::Boolean:
+		return m_Data.m_AsBool == rOther.m_Data.m_AsBool;
+	case CommandArgVariableType::CString: {
+		const char * pCString = GetCStringPtr();
+		const char * pOtherCString = rOther.GetCStringPtr();
+		if (pCString == nullptr || pOtherCString == nullptr) {
+			return pCString == pOtherCString;
+		}
+		return strcmp(pCString, pOtherCString) == 0;
+	}
+	default:
+		return true;
+	}
+}
+
+void CommandArgValue::CopyCString(const char * pString) {
+	if (m_Type == CommandArgVariableType::CString) {
+		StoreCStringCopy(pString, strlen(pString));
+	}
+}
+
+void CommandArgValue::StoreCStringCopy(const char * pString, const size_t stringLen) {
+	const size_t stringSize = stringLen + 1;
+	if (stringSize <= ms_InlineCStringCapacity) {
+		// Copy first in case pString points at our own storage
+		char inlineString[ms_InlineCStringCapacity];
+		memcpy(inlineString, pString, stringLen);
+		inlineString[stringLen] = '\0';
+		SetCString(nullptr);
+		memcpy(m_Data.m_AsInlineCString, inlineString, stringSize);
+		m_Flags |= CommandArgVariableFlags::InlineCString;
+		return;
+	}
+	char * deepStringCopy = new char[stringSize];
+	memcpy(deepStringCopy, pString, stringLen);
+	deepStringCopy[stringLen] = '\0';
+	SetCString(deepStringCopy);
+	m_Flags |= CommandArgVariableFlags::OwnsCString;
+}
+
+CommandArgVariable::CommandArgVariable(const char * pVariableName, const CommandArgVariableType::Type nType, const int defaultIntValue, const uint8_t flags) : m_pValue(CommandArgsMgr::GetInstance().AllocateVariableValue(this, nType, flags)), m_pOwnerMgr(nullptr), m_Index(ms_InvalidIndex), m_Key(0) {
+	assert(nType == CommandArgVariableType::Integer);
+	CommandArgsMgr::GetInstance().RegisterCommandArgVariableByName(pVariableName, this);
+	m_pValue->SetInt(defaultIntValue);
+}
+
+CommandArgVariable::CommandArgVariable(const char * pVariableName, const CommandArgVariableType::Type nType, const bool defaultBoolValue, const uint8_t flags) : m_pValue(CommandArgsMgr::GetInstance().AllocateVariableValue(this, nType, flags)), m_pOwnerMgr(nullptr), m_Index(ms_InvalidIndex), m_Key(0) {
+	assert(nType == CommandArgVariableType::Boolean);
+	CommandArgsMgr::GetInstance().RegisterCommandArgVariableByName(pVariableName, this);
+	m_pValue->SetBool(defaultBoolValue);
+}
+
+CommandArgVariable::CommandArgVariable(const char * pVariableName, const CommandArgVariableType::Type nType, const float defaultFloatValue, const uint8_t flags) : m_pValue(CommandArgsMgr::GetInstance().AllocateVariableValue(this, nType, flags)), m_pOwnerMgr(nullptr), m_Index(ms_InvalidIndex), m_Key(0) {
+	assert(nType == CommandArgVariableType::Float);
+	CommandArgsMgr::GetInstance().RegisterCommandArgVariableByName(pVariableName, this);
+	m_pValue->SetFloat(defaultFloatValue);
+}
+
+CommandArgVariable::CommandArgVariable(const char * pVariableName, const CommandArgVariableType::Type nType, const char * defaultCStringValue, const uint8_t flags) : m_pValue(CommandArgsMgr::GetInstance().AllocateVariableValue(this, nType, flags)), m_pOwnerMgr(nullptr), m_Index(ms_InvalidIndex), m_Key(0) {
+	assert(nType == CommandArgVariableType::CString);
+	CommandArgsMgr::GetInstance().RegisterCommandArgVariableByName(pVariableName, this);
+	if (!(flags & CommandArgVariableFlags::OwnsCString) && defaultCStringValue != nullptr && strlen(defaultCStringValue) < CommandArgValue::ms_InlineCStringCapacity) {
+		m_pValue->CopyCString(defaultCStringValue);
+	} else {
+		m_pValue->SetCString(defaultCStringValue);
+		m_pValue->SetFlags(flags);
+	}
+}
+
+CommandArgVariable::CommandArgVariable(const uint32_t variableHash, const CommandArgVariableType::Type nType, const int defaultIntValue, const uint8_t flags /*= 0*/) : m_pValue(CommandArgsMgr::GetInstance().AllocateVariableValue(this, nType, flags)), m_pOwnerMgr(nullptr), m_Index(ms_InvalidIndex), m_Key(0) {
+	assert(nType == CommandArgVariableType::Integer);
+	CommandArgsMgr::GetInstance().RegisterCommandArgVariableByHash(variableHash, this);
+	m_pValue->SetInt(defaultIntValue);
+}
+
+CommandArgVariable::CommandArgVariable(const uint32_t variableHash, const CommandArgVariableType::Type nType, const bool defaultBoolValue, const uint8_t flags) : m_pValue(CommandArgsMgr::GetInstance().AllocateVariableValue(this, nType, flags)), m_pOwnerMgr(nullptr), m_Index(ms_InvalidIndex), m_Key(0) {
+	assert(nType == CommandArgVariableType::Boolean);
+	CommandArgsMgr::GetInstance().RegisterCommandArgVariableByHash(variableHash, this);
+	m_pValue->SetBool(defaultBoolValue);
+}
+
+CommandArgVariable::CommandArgVariable(const uint32_t variableHash, const CommandArgVariableType::Type nType, const float defaultFloatValue, const uint8_t flags) : m_pValue(CommandArgsMgr::GetInstance().AllocateVariableValue(this, nType, flags)), m_pOwnerMgr(nullptr), m_Index(ms_InvalidIndex), m_Key(0) {
+	assert(nType == CommandArgVariableType::Float);
+	CommandArgsMgr::GetInstance().RegisterCommandArgVariableByHash(variableHash, this);
+	m_pValue->SetFloat(defaultFloatValue);
+}
+
+CommandArgVariable::CommandArgVariable(const uint32_t variableHash, const CommandArgVariableType::Type nType, const char * defaultCStringValue, const uint8_t flags) : m_pValue(CommandArgsMgr::GetInstance().AllocateVariableValue(this, nType, flags)), m_pOwnerMgr(nullptr), m_Index(ms_InvalidIndex), m_Key(0) {
+	assert(nType == CommandArgVariableType::CString);
+	CommandArgsMgr::GetInstance().RegisterCommandArgVariableByHash(variableHash, this);
+	if (!(flags & CommandArgVariableFlags::OwnsCString) && defaultCStringValue != nullptr && strlen(defaultCStringValue) < CommandArgValue::ms_InlineCStringCapacity) {
+		m_pValue->CopyCString(defaultCStringValue);
+	} else {
+		m_pValue->SetCString(defaultCStringValue);
+		m_pValue->SetFlags(flags);
+	}
+}
+
+CommandArgVariable::~CommandArgVariable() {
+	CommandArgsMgr::GetInstance().UnregisterVariable(this);
+}
+
+void CommandArgVariable::SetInt(const int i) {
+	if (GetType() == CommandArgVariableType::Integer && m_pValue->GetInt() != i) {
+		m_pValue->SetInt(i);
+		MarkDirty();
+	}
+}
+
+void CommandArgVariable::SetFloat(const float f) {
+	if (GetType() == CommandArgVariableType::Float && m_pValue->GetFloat() != f) {
+		m_pValue->SetFloat(f);
+		MarkDirty();
+	}
+}
+
+void CommandArgVariable::SetBool(const bool b) {
+	if (GetType() == CommandArgVariableType::Boolean && m_pValue->GetBool() != b) {
+		m_pValue->SetBool(b);
+		MarkDirty();
+	}
+}
+
+void CommandArgVariable::SetCString(const char * pString) {
+	if (GetType() == CommandArgVariableType::CString) {
+		const char * pCurCString = m_pValue->GetCString();
+		const bool bChanged = (pCurCString == nullptr || pString == nullptr) ? (pCurCString != pString) : (strcmp(pCurCString, pString) != 0);
+		m_pValue->SetCString(pString);
+		if (bChanged) {
+			MarkDirty();
+		}
+	}
+}
+
+void CommandArgVariable::SetValue(CommandArgValue && rValue) {
+	if (rValue.GetType() == GetType()) {
+		const bool bChanged = !m_pValue->Equals(rValue);
+		*m_pValue = std::move(rValue);
+		if (bChanged) {
+			MarkDirty();
+		}
+	}
+}
+
+void CommandArgVariable::MarkDirty() {
+	if (m_pOwnerMgr != nullptr) {
+		m_pOwnerMgr->MarkVariableDirty(m_Index);
+	}
+}
+
 const char * CommandArgsParser::ms_DefaultDelimeters = " \t\n\v\f\r";
 
 bool CommandArgsParser::Parse_Bool(const char * pString, bool & rInOutBool) {
@@ -169,7 +449,253 @@ bool CommandArgsParser::Parse_Float(const char * pString, float & rInOutFloat) {
 	return true;
 }
 
-CommandArgsParser::CommandArgsParser() : m_pCurrentToken(nullptr), m_pInputString(nullptr), m_pInputStringTokenize(nullptr), m_pNextToken(nullptr), m_bHasProcessedFirstToken(false) {
+/// State carried from one block to the next while scanning a token
+struct TokenScanState {
+	uint64_t m_EscapeCarry;		// 1 if the first character of the next block is escaped
+	uint64_t m_InQuoteCarry;	// All ones if the next block starts inside quotes
+	char m_cActiveQuote;
+};
+
+static void ClassifyTokenBlock(const char * pBlock, const char * pEnd, const char * pDelimeters, CommandArgsTokenBlockMasks & rOutMasks) {
+	// Never read past the terminating null, the last partial block is copied and zero padded
+	char paddedBlock[64];
+	if (pEnd - pBlock < 63) {
+		memset(paddedBlock, 0, sizeof(paddedBlock));
+		memcpy(paddedBlock, pBlock, pEnd - pBlock);
+		pBlock = paddedBlock;
+	}
+	memset(&rOutMasks, 0, sizeof(rOutMasks));
+	const bool bDefaultDelimeters = (pDelimeters == CommandArgsParser::ms_DefaultDelimeters);
+#if COMMAND_ARGS_PARSER_USE_SSE2
+	for (int chunk = 0; chunk < 4; ++chunk) {
+		const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pBlock + chunk * 16));
+		__m128i delimeters = _mm_setzero_si128();
+		if (bDefaultDelimeters) {
+			// Space or \t \n \v \f \r which are the contiguous range 9-13
+			const __m128i controlOffset = _mm_sub_epi8(chars, _mm_set1_epi8(9));
+			const __m128i isControl = _mm_cmpeq_epi8(_mm_min_epu8(controlOffset, _mm_set1_epi8(4)), controlOffset);
+			delimeters = _mm_or_si128(isControl, _mm_cmpeq_epi8(chars, _mm_set1_epi8(' ')));
+		} else {
+			for (const char * pDelimeter = pDelimeters; *pDelimeter; ++pDelimeter) {
+				delimeters = _mm_or_si128(delimeters, _mm_cmpeq_epi8(chars, _mm_set1_epi8(*pDelimeter)));
+			}
+		}
+		const int shift = chunk * 16;
+		rOutMasks.m_Delimeters |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(delimeters))) << shift;
+		rOutMasks.m_Terminators |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chars, _mm_setzero_si128())))) << shift;
+		rOutMasks.m_DoubleQuotes |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chars, _mm_set1_epi8('"'))))) << shift;
+		rOutMasks.m_SingleQuotes |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chars, _mm_set1_epi8('\''))))) << shift;
+		rOutMasks.m_Backslashes |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chars, _mm_set1_epi8('\\'))))) << shift;
+	}
+#else
+	for (int i = 0; i < 64; ++i) {
+		const char cCur = pBlock[i];
+		uint64_t isDelimeter = 0;
+		if (bDefaultDelimeters) {
+			isDelimeter = (cCur == ' ') | (static_cast<uint8_t>(cCur - 9) <= 4);
+		} else {
+			for (const char * pDelimeter = pDelimeters; *pDelimeter; ++pDelimeter) {
+				isDelimeter |= (cCur == *pDelimeter);
+			}
+		}
+		rOutMasks.m_Delimeters |= isDelimeter << i;
+		rOutMasks.m_Terminators |= static_cast<uint64_t>(cCur == '\0') << i;
+		rOutMasks.m_DoubleQuotes |= static_cast<uint64_t>(cCur == '"') << i;
+		rOutMasks.m_SingleQuotes |= static_cast<uint64_t>(cCur == '\'') << i;
+		rOutMasks.m_Backslashes |= static_cast<uint64_t>(cCur == '\\') << i;
+	}
+#endif //
+}
+
+/// Bit N of the result is the xor of bits 0..N, turns quote positions into a quoted region mask
+static inline uint64_t PrefixXor(const uint64_t bits) {
+#if COMMAND_ARGS_PARSER_USE_PCLMUL
+	const __m128i result = _mm_clmulepi64_si128(_mm_set_epi64x(0, static_cast<int64_t>(bits)), _mm_set1_epi8(static_cast<char>(0xff)), 0);
+	return static_cast<uint64_t>(_mm_cvtsi128_si64(result));
+#else
+	uint64_t result = bits;
+	result ^= result << 1;
+	result ^= result << 2;
+	result ^= result << 4;
+	result ^= result << 8;
+	result ^= result << 16;
+	result ^= result << 32;
+	return result;
+#endif //
+}
+
+/// Advances the scan state over numValidBits characters of a block
+/// rOutEnds gets the unquoted, unescaped delimiters and the terminators
+/// rOutDropped gets the escaping backslashes and the quotes that open or close a quoted region
+/// Returns false if the block mixes unescaped " and ' which the masks can't resolve
+static bool ScanTokenBlock(const CommandArgsTokenBlockMasks & rMasks, const uint32_t numValidBits, TokenScanState & rState, uint64_t & rOutEnds, uint64_t & rOutDropped) {
+	const uint64_t evenBits = 0x5555555555555555ULL;
+	const uint64_t oddBits = ~evenBits;
+	const uint32_t lastBit = numValidBits - 1;
+	// A run of backslashes alternates escaping/escaped starting from the first one in the run
+	const uint64_t backslashes = rMasks.m_Backslashes & ~rState.m_EscapeCarry;
+	const uint64_t runStarts = backslashes & ~(backslashes << 1);
+	const uint64_t evenStartRuns = backslashes & ~(backslashes + (runStarts & evenBits));
+	const uint64_t oddStartRuns = backslashes & ~evenStartRuns;
+	const uint64_t escaping = (evenStartRuns & evenBits) | (oddStartRuns & oddBits);
+	const uint64_t escaped = (escaping << 1) | rState.m_EscapeCarry;
+	rState.m_EscapeCarry = (escaping >> lastBit) & 1;
+
+	const uint64_t doubleQuotes = rMasks.m_DoubleQuotes & ~escaped;
+	const uint64_t singleQuotes = rMasks.m_SingleQuotes & ~escaped;
+	if (doubleQuotes != 0 && singleQuotes != 0) {
+		return false;
+	}
+	// Inside quotes only the matching quote counts, the other kind is a literal character
+	char cQuote = rState.m_cActiveQuote;
+	if (rState.m_InQuoteCarry == 0) {
+		cQuote = (singleQuotes != 0) ? '\'' : '"';
+	}
+	const uint64_t quotes = (cQuote == '"') ? doubleQuotes : singleQuotes;
+	const uint64_t inQuotes = PrefixXor(quotes) ^ rState.m_InQuoteCarry;
+	rState.m_InQuoteCarry = 0 - ((inQuotes >> lastBit) & 1);
+	rState.m_cActiveQuote = cQuote;
+
+	rOutEnds = (rMasks.m_Delimeters & ~inQuotes & ~escaped) | rMasks.m_Terminators;
+	rOutDropped = escaping | quotes;
+	return true;
+}
+
+void CommandArgsParser::LoadTokenBlockMasks(const char * pPosition, const char * pDelimeters, CommandArgsTokenBlockMasks & rOutMasks, uint32_t & rOutNumValidBits) {
+	// Blocks are aligned to the start of the input so consecutive tokens share the cached block
+	const char * pBlockStart = m_pInputStringTokenize + ((pPosition - m_pInputStringTokenize) & ~static_cast<ptrdiff_t>(63));
+	if (pBlockStart != m_pBlockMasksStart || pDelimeters != m_pBlockMasksDelimeters) {
+		ClassifyTokenBlock(pBlockStart, m_pInputStringEnd, pDelimeters, m_BlockMasks);
+		m_pBlockMasksStart = pBlockStart;
+		m_pBlockMasksDelimeters = pDelimeters;
+	}
+	// Bit 0 is pPosition from here on
+	const uint32_t offset = static_cast<uint32_t>(pPosition - pBlockStart);
+	rOutMasks.m_Delimeters = m_BlockMasks.m_Delimeters >> offset;
+	rOutMasks.m_Terminators = m_BlockMasks.m_Terminators >> offset;
+	rOutMasks.m_DoubleQuotes = m_BlockMasks.m_DoubleQuotes >> offset;
+	rOutMasks.m_SingleQuotes = m_BlockMasks.m_SingleQuotes >> offset;
+	rOutMasks.m_Backslashes = m_BlockMasks.m_Backslashes >> offset;
+	rOutNumValidBits = 64 - offset;
+}
+
+char * CommandArgsParser::FindTokenEnd(char * pTokenStart, const char * pDelimeters, bool & rbOutNeedsUnquote) {
+	TokenScanState sState;
+	memset(&sState, 0, sizeof(sState));
+	rbOutNeedsUnquote = false;
+	for (char * pBlock = pTokenStart; ; ) {
+		CommandArgsTokenBlockMasks sMasks;
+		uint32_t numValidBits = 0;
+		LoadTokenBlockMasks(pBlock, pDelimeters, sMasks, numValidBits);
+		uint64_t ends = 0, dropped = 0;
+		if ((sMasks.m_DoubleQuotes | sMasks.m_SingleQuotes | sMasks.m_Backslashes | sState.m_EscapeCarry | sState.m_InQuoteCarry) == 0) {
+			// Nothing quoted or escaped, which is the common case
+			ends = sMasks.m_Delimeters | sMasks.m_Terminators;
+		} else if (!ScanTokenBlock(sMasks, numValidBits, sState, ends, dropped)) {
+			return nullptr;
+		}
+		if (ends != 0) {
+			const uint32_t endIndex = CountTrailingZeros64(ends);
+			rbOutNeedsUnquote |= (dropped & ((uint64_t(1) << endIndex) - 1)) != 0;
+			return pBlock + endIndex;
+		}
+		rbOutNeedsUnquote |= (dropped != 0);
+		pBlock += numValidBits;
+	}
+}
+
+size_t CommandArgsParser::UnquoteTokenWithMasks(char * pTokenStart, char * pTokenEnd, const char * pDelimeters) {
+	TokenScanState sState;
+	memset(&sState, 0, sizeof(sState));
+	char * pWrite = pTokenStart;
+	for (char * pBlock = pTokenStart; pBlock < pTokenEnd; ) {
+		// Only ever writes behind the block being read so the masks still describe the original text
+		CommandArgsTokenBlockMasks sMasks;
+		uint32_t numValidBits = 0;
+		LoadTokenBlockMasks(pBlock, pDelimeters, sMasks, numValidBits);
+		uint64_t ends = 0, dropped = 0;
+		ScanTokenBlock(sMasks, numValidBits, sState, ends, dropped);
+		const size_t blockLength = (pTokenEnd - pBlock < numValidBits) ? static_cast<size_t>(pTokenEnd - pBlock) : numValidBits;
+		if (blockLength < 64) {
+			dropped &= (uint64_t(1) << blockLength) - 1;
+		}
+		size_t keepStart = 0;
+		while (dropped != 0) {
+			const size_t dropIndex = CountTrailingZeros64(dropped);
+			dropped &= dropped - 1;
+			memmove(pWrite, pBlock + keepStart, dropIndex - keepStart);
+			pWrite += dropIndex - keepStart;
+			keepStart = dropIndex + 1;
+		}
+		memmove(pWrite, pBlock + keepStart, blockLength - keepStart);
+		pWrite += blockLength - keepStart;
+		pBlock += blockLength;
+	}
+	return pWrite - pTokenStart;
+}
+
+/// Character by character version of the quote/escape rules, pOutBuffer may alias pString
+/// Stops after the first token if bFirstTokenOnly, otherwise at a comment or the end of the string
+/// Returns the input character it stopped on, rOutLength gets the unquoted length
+static const char * ScanQuotedArgs(const char * pString, char * pOutBuffer, const size_t bufferSize, const bool bFirstTokenOnly, const char * pDelimeters, size_t & rOutLength) {
+	size_t numWritten = 0;
+	size_t numSignificant = 0;	// Excludes trailing unquoted delimiters
+	char cQuote = 0;
+	bool bAtTokenStart = true;
+	const char * pCur = pString;
+	for (; *pCur; ++pCur) {
+		char cCur = *pCur;
+		if (cCur == '\\') {
+			++pCur;
+			if (*pCur == '\0') {
+				break;
+			}
+			cCur = *pCur;
+		} else if (cQuote != 0) {
+			if (cCur == cQuote) {
+				cQuote = 0;
+				continue;
+			}
+		} else if (cCur == '"' || cCur == '\'') {
+			cQuote = cCur;
+			bAtTokenStart = false;
+			continue;
+		} else if (strchr(pDelimeters, cCur) != nullptr) {
+			if (bFirstTokenOnly) {
+				break;
+			}
+			if (numWritten + 1 < bufferSize) {
+				pOutBuffer[numWritten] = cCur;
+			}
+			++numWritten;
+			bAtTokenStart = true;
+			continue;
+		} else if (bAtTokenStart && CommandArgsParser::IsCommentStart(pCur)) {
+			break;
+		}
+		if (numWritten + 1 < bufferSize) {
+			pOutBuffer[numWritten] = cCur;
+		}
+		++numWritten;
+		numSignificant = numWritten;
+		bAtTokenStart = false;
+	}
+	// Doesn't null terminate, the caller might still need the character it stopped on
+	rOutLength = (numSignificant + 1 < bufferSize) ? numSignificant : (bufferSize > 0 ? bufferSize - 1 : 0);
+	return pCur;
+}
+
+size_t CommandArgsParser::UnquoteArgs(const char * pString, char * pOutBuffer, const size_t bufferSize, const bool bFirstTokenOnly, const char * pDelimeters /*= ms_DefaultDelimeters*/) {
+	if (!pString || !pOutBuffer || bufferSize == 0) {
+		return 0;
+	}
+	size_t outLength = 0;
+	ScanQuotedArgs(pString, pOutBuffer, bufferSize, bFirstTokenOnly, pDelimeters, outLength);
+	pOutBuffer[outLength] = '\0';
+	return outLength;
+}
+
+CommandArgsParser::CommandArgsParser() : m_pCurrentToken(nullptr), m_pInputString(nullptr), m_pInputStringTokenize(nullptr), m_pInputStringEnd(nullptr), m_pNextToken(nullptr), m_pBlockMasksStart(nullptr), m_pBlockMasksDelimeters(nullptr), m_pCommandArgsMgr(nullptr), m_bHasProcessedFirstToken(false) {
 
 }
 
@@ -193,19 +719,65 @@ void CommandArgsParser::InitWithArgs(char * pFullString) {
 #else
 	m_pInputStringTokenize = pFullString;
 #endif
+	// Found when the first quoted token needs the block masks, plain input never pays for the strlen
+	m_pInputStringEnd = nullptr;
+	m_pBlockMasksStart = nullptr;
+}
+
+static inline bool IsTokenDelimeter(const char cCur, const char * pDelimeters) {
+	if (pDelimeters == CommandArgsParser::ms_DefaultDelimeters) {
+		return cCur == ' ' || static_cast<uint8_t>(cCur - 9) <= 4;
+	}
+	return cCur != '\0' && strchr(pDelimeters, cCur) != nullptr;
 }
 
 char * CommandArgsParser::IncrementToken(const char * pDelimeters /*= ms_DefaultDelimeters*/) {
-	char * pCurToken = nullptr;
 	if (!m_bHasProcessedFirstToken) {
-		pCurToken = strtok_s(m_pInputStringTokenize, pDelimeters, &m_pNextToken);
+		m_pNextToken = m_pInputStringTokenize;
+		m_bHasProcessedFirstToken = true;
 	}
-	else {
-		pCurToken = strtok_s(nullptr, pDelimeters, &m_pNextToken);
+	m_pCurrentToken = nullptr;
+	if (!m_pNextToken) {
+		return nullptr;
+	}
+	char * pTokenStart = m_pNextToken;
+	while (IsTokenDelimeter(*pTokenStart, pDelimeters)) {
+		++pTokenStart;
+	}
+	if (*pTokenStart == '\0' || IsCommentStart(pTokenStart)) {
+		m_pNextToken = nullptr;
+		return nullptr;
 	}
-	m_pCurrentToken = pCurToken;
-	m_bHasProcessedFirstToken = true;
-	return pCurToken;
+	// Most tokens are short and plain, a scalar scan finds their end faster than building masks
+	// The block masks only take over once a quote or backslash shows up
+	char * pTokenEnd = pTokenStart;
+	bool bIsPlainToken = true;
+	for (; *pTokenEnd != '\0' && !IsTokenDelimeter(*pTokenEnd, pDelimeters); ++pTokenEnd) {
+		if (*pTokenEnd == '"' || *pTokenEnd == '\'' || *pTokenEnd == '\\') {
+			bIsPlainToken = false;
+			break;
+		}
+	}
+	bool bNeedsUnquote = false;
+	if (!bIsPlainToken) {
+		if (m_pInputStringEnd == nullptr) {
+			m_pInputStringEnd = pTokenEnd + strlen(pTokenEnd);
+		}
+		pTokenEnd = FindTokenEnd(pTokenStart, pDelimeters, bNeedsUnquote);
+	}
+	size_t tokenLength = 0;
+	if (!pTokenEnd) {
+		// Mixed quote kinds, fall back to the character by character rules
+		pTokenEnd = const_cast<char *>(ScanQuotedArgs(pTokenStart, pTokenStart, static_cast<size_t>(m_pInputStringEnd - pTokenStart) + 1, true, pDelimeters, tokenLength));
+	} else if (bNeedsUnquote) {
+		tokenLength = UnquoteTokenWithMasks(pTokenStart, pTokenEnd, pDelimeters);
+	} else {
+		tokenLength = pTokenEnd - pTokenStart;
+	}
+	m_pNextToken = (*pTokenEnd != '\0') ? pTokenEnd + 1 : nullptr;
+	pTokenStart[tokenLength] = '\0';
+	m_pCurrentToken = pTokenStart;
+	return pTokenStart;
 }
 
 bool CommandArgsParser::CompareToken(const char * pCurToken, const char * pToCompareTo) const {
@@ -265,7 +837,8 @@ bool CommandArgsParser::IncrementTokenAndParseVector3(float & fx, float & fy, fl
 }
 
 void CommandArgsParser::Reset() {
-	m_pInputString = m_pCurrentToken = m_pNextToken = nullptr;
+	m_pInputString = m_pCurrentToken = m_pNextToken = m_pInputStringEnd = nullptr;
+	m_pBlockMasksStart = m_pBlockMasksDelimeters = nullptr;
 	m_bHasProcessedFirstToken = false;
 #if COMMANDS_ARGS_PARSER_MAKES_COPY_OF_INPUT_STRING
 	if (m_pInputStringTokenize != nullptr) {
@@ -314,8 +887,30 @@ void CommandArgEntry::SetType(const CommandArgEntryType::Type nType) {
 	m_Type = nType;
 }
 
+uint32_t CommandArgsMgr::ms_NumRegisteredVariables = 0;
+std::vector<std::shared_ptr<const CommandArgsFile>> CommandArgsMgr::ms_ArgsFileCache;
+std::mutex CommandArgsMgr::ms_ArgsFileCacheMutex;
+std::atomic<uint64_t> CommandArgsMgr::ms_ChangeEpoch(0);
+std::mutex CommandArgsMgr::ms_ChildRegistriesMutex;
 CommandArgsMgr CommandArgsMgr::ms_Instance;
 
+CommandArgsMgr::CommandArgsMgr(CommandArgsMgr * pParent /*= nullptr*/) : m_LookupSlotShift(32), m_pParent(pParent), m_pEnvironmentPrefix(nullptr), m_LastDispatchEpoch(0), m_NextSubscriptionHandle(1), m_bIsDispatching(false), m_bHasUnsubscribedWhileDispatching(false), m_bLazyValueParsing(false) {
+	if (m_pParent != nullptr) {
+		// Per session registries get created on worker threads, all sharing GetInstance() as their parent
+		std::lock_guard<std::mutex> lock(ms_ChildRegistriesMutex);
+		m_pParent->m_Children.push_back(this);
+	}
+}
+
+CommandArgsMgr::~CommandArgsMgr() {
+	if (m_pParent != nullptr) {
+		std::lock_guard<std::mutex> lock(ms_ChildRegistriesMutex);
+		std::vector<CommandArgsMgr *> & rSiblings = m_pParent->m_Children;
+		rSiblings.erase(std::remove(rSiblings.begin(), rSiblings.end(), this), rSiblings.end());
+	}
+	ReleaseVariableValues();
+}
+
 // Jenkins One At A Time for these hash functions
 uint32_t CommandArgsMgr::HashCommandLineArg(const char * pString) {
 	if (!pString) { return 0; }
@@ -397,6 +992,12 @@ void CommandArgsMgr::RegisterCommandArgVariableByHash(const uint32_t argHashValu
 		sNewEntry.SetType(CommandArgEntryType::Variable);
 		sNewEntry.SetVariable(ptr);
 		m_CommandArgsMap.insert(std::make_pair(argHashValue, sNewEntry));
+		AddLookupSlot(argHashValue, &ptr->GetValue());
+		if (ptr->m_Index == CommandArgVariable::ms_InvalidIndex) {
+			ptr->m_Index = ms_NumRegisteredVariables++;
+			ptr->m_pOwnerMgr = this;
+			ptr->m_Key = argHashValue;
+		}
 	}
 }
 
@@ -412,6 +1013,7 @@ void CommandArgsMgr::RegisterCommandArgFunctionByName(const char * pArgName, con
 		sEntry.SetType(CommandArgEntryType::Function);
 		sEntry.SetFunction(pFunc);
 		m_CommandArgsMap.insert(std::make_pair(hashValue, sEntry));
+		AddLookupSlot(hashValue, nullptr);
 	}
 }
 
@@ -423,110 +1025,653 @@ void CommandArgsMgr::RegisterCommandArgFunctionByHash(const uint32_t commandHash
 		sEntry.SetType(CommandArgEntryType::Function);
 		sEntry.SetFunction(pFunc);
 		m_CommandArgsMap.insert(std::make_pair(commandHashValue, sEntry));
+		AddLookupSlot(commandHashValue, nullptr);
 	}
 }
 
 int CommandArgsMgr::GetIntegerForKey(const uint32_t key) {
-	std::unordered_map<uint32_t, CommandArgEntry>::const_iterator cit = m_CommandArgsMap.find(key);
-	if (cit != m_CommandArgsMap.cend()) {
-		const CommandArgEntry & rEntry = cit->second;
-		if (rEntry.GetType() == CommandArgEntryType::Variable) {
-			const CommandArgVariable * pVariable = rEntry.GetVariable();
-			if (pVariable != nullptr) {
-				if (pVariable->GetType() == CommandArgVariableType::Integer) {
-					return pVariable->GetInt();
-				}
-			}
+	const CommandArgValue * pValue = FindValueForKey(key);
+	if (pValue != nullptr) {
+		if (pValue->GetType() == CommandArgVariableType::Integer) {
+			return pValue->GetInt();
 		}
 	}
 	return 0;
 }
 
 float CommandArgsMgr::GetFloatForKey(const uint32_t key) {
-	std::unordered_map<uint32_t, CommandArgEntry>::const_iterator cit = m_CommandArgsMap.find(key);
-	if (cit != m_CommandArgsMap.cend()) {
-		const CommandArgEntry & rEntry = cit->second;
-		if (rEntry.GetType() == CommandArgEntryType::Variable) {
-			const CommandArgVariable * pVariable = rEntry.GetVariable();
-			if (pVariable != nullptr) {
-				if (pVariable->GetType() == CommandArgVariableType::Float) {
-					return pVariable->GetFloat();
-				}
-			}
+	const CommandArgValue * pValue = FindValueForKey(key);
+	if (pValue != nullptr) {
+		if (pValue->GetType() == CommandArgVariableType::Float) {
+			return pValue->GetFloat();
 		}
 	}
 	return 0.0f;
 }
 
 bool CommandArgsMgr::GetBoolForKey(const uint32_t key) {
-	std::unordered_map<uint32_t, CommandArgEntry>::const_iterator cit = m_CommandArgsMap.find(key);
-	if (cit != m_CommandArgsMap.cend()) {
-		const CommandArgEntry & rEntry = cit->second;
-		if (rEntry.GetType() == CommandArgEntryType::Variable) {
-			const CommandArgVariable * pVariable = rEntry.GetVariable();
-			if (pVariable != nullptr) {
-				if (pVariable->GetType() == CommandArgVariableType::Boolean) {
-					return pVariable->GetBool();
-				}
-			}
+	const CommandArgValue * pValue = FindValueForKey(key);
+	if (pValue != nullptr) {
+		if (pValue->GetType() == CommandArgVariableType::Boolean) {
+			return pValue->GetBool();
 		}
 	}
 	return false;
 }
 
 const char * CommandArgsMgr::GetCStringForKey(const uint32_t key) {
-	std::unordered_map<uint32_t, CommandArgEntry>::const_iterator cit = m_CommandArgsMap.find(key);
-	if (cit != m_CommandArgsMap.cend()) {
-		const CommandArgEntry & rEntry = cit->second;
-		if (rEntry.GetType() == CommandArgEntryType::Variable) {
-			const CommandArgVariable * pVariable = rEntry.GetVariable();
-			if (pVariable != nullptr) {
-				if (pVariable->GetType() == CommandArgVariableType::CString) {
-					return pVariable->GetCString();
-				}
-			}
+	const CommandArgValue * pValue = FindValueForKey(key);
+	if (pValue != nullptr) {
+		if (pValue->GetType() == CommandArgVariableType::CString) {
+			return pValue->GetCString();
 		}
 	}
 	return "\0";
 }
 
-void CommandArgsMgr::SetupAllCommandArgs(const int argc, char * argv[]) {
-	if (argc >= 2) {
-		const char * pFileToReadFrom = argv[1];
-		std::ifstream inputFile(pFileToReadFrom);
-		std::string curLine;
-		while (std::getline(inputFile, curLine)) {
-			const char * pCurArgFull = curLine.c_str();
-			Execute(pCurArgFull);
+/// Same defaults the single key getters return
+static void SetDefaultGetResult(const CommandArgVariableType::Type nType, CommandArgGetResult & rOutResult) {
+	if (nType == CommandArgVariableType::CString) {
+		rOutResult.m_AsCString = "\0";
+	} else if (nType == CommandArgVariableType::Float) {
+		rOutResult.m_AsFloat = 0.0f;
+	} else if (nType == CommandArgVariableType::Boolean) {
+		rOutResult.m_AsBool = false;
+	} else {
+		rOutResult.m_AsInt = 0;
+	}
+}
+
+uint32_t CommandArgsMgr::GetMany(const uint32_t * pKeys, const CommandArgVariableType::Type * pTypes, const size_t numKeys, CommandArgGetResult * pOutResults, uint8_t * pOutStatuses) {
+	// Each step of a lookup is a likely cache miss (slot, value), so every step is 
+	// prefetched for the whole batch before the first one is read
+	const size_t batchSize = 16;
+	const CommandArgValue * batchValues[batchSize];
+	size_t pendingIndices[batchSize];
+	uint32_t numFound = 0;
+	for (size_t batchStart = 0; batchStart < numKeys; batchStart += batchSize) {
+		const size_t numBatchKeys = (numKeys - batchStart > batchSize) ? batchSize : numKeys - batchStart;
+		const uint32_t * pBatchKeys = pKeys + batchStart;
+		size_t numPending = numBatchKeys;
+		for (size_t i = 0; i < numBatchKeys; ++i) {
+			batchValues[i] = nullptr;
+			pendingIndices[i] = i;
+		}
+		// Same search order as FindValueForKey(), keys not found at a level move on to its parent
+		for (const CommandArgsMgr * pMgr = this; pMgr != nullptr && numPending > 0; pMgr = pMgr->m_pParent) {
+			if (!pMgr->m_LookupSlots.empty()) {
+				for (size_t p = 0; p < numPending; ++p) {
+					COMMAND_ARGS_PREFETCH(&pMgr->m_LookupSlots[pMgr->GetLookupSlotIndex(pBatchKeys[pendingIndices[p]])]);
+				}
+			}
+			size_t numStillPending = 0;
+			for (size_t p = 0; p < numPending; ++p) {
+				const size_t batchIndex = pendingIndices[p];
+				const uint32_t key = pBatchKeys[batchIndex];
+				if (!pMgr->m_LocalValues.empty()) {
+					std::unordered_map<uint32_t, CommandArgValue>::const_iterator vit = pMgr->m_LocalValues.find(key);
+					if (vit != pMgr->m_LocalValues.cend()) {
+						batchValues[batchIndex] = &vit->second;
+						COMMAND_ARGS_PREFETCH(&vit->second);
+						continue;
+					}
+				}
+				const LookupSlot * pSlot = pMgr->FindLookupSlot(key);
+				if (pSlot == nullptr) {
+					pendingIndices[numStillPending++] = batchIndex;
+				} else if (pSlot->m_pValue != nullptr) {
+					batchValues[batchIndex] = pSlot->m_pValue;
+					COMMAND_ARGS_PREFETCH(pSlot->m_pValue);
+				}
+				// A function with the key ends the search without a value
+			}
+			numPending = numStillPending;
+		}
+		for (size_t i = 0; i < numBatchKeys; ++i) {
+			const CommandArgValue * pValue = batchValues[i];
+			const CommandArgVariableType::Type nType = pTypes[batchStart + i];
+			CommandArgGetResult & rResult = pOutResults[batchStart + i];
+			uint8_t & rStatus = pOutStatuses[batchStart + i];
+			if (pValue == nullptr || pValue->GetType() != nType) {
+				rStatus = (pValue == nullptr) ? CommandArgGetStatus::NotFound : CommandArgGetStatus::TypeMismatch;
+				SetDefaultGetResult(nType, rResult);
+				continue;
+			}
+			switch (nType) {
+			case CommandArgVariableType::Integer:
+				rResult.m_AsInt = pValue->GetInt();
+				break;
+			case CommandArgVariableType::Float:
+				rResult.m_AsFloat = pValue->GetFloat();
+				break;
+			case CommandArgVariableType::Boolean:
+				rResult.m_AsBool = pValue->GetBool();
+				break;
+			case CommandArgVariableType::CString:
+				rResult.m_AsCString = pValue->GetCString();
+				break;
+			default:
+				rResult.m_AsInt = 0;
+				break;
+			}
+			rStatus = CommandArgGetStatus::Found;
+			++numFound;
 		}
 	}
+	return numFound;
 }
 
-int CommandArgsMgr::Execute(const char * pCommand) {
-	if (!pCommand) {
-		return 0;
+const CommandArgsMgr::LookupSlot * CommandArgsMgr::FindLookupSlot(const uint32_t key) const {
+	if (m_LookupSlots.empty()) {
+		return nullptr;
 	}
-	// A valid argument is just giving the name of a flag which implies turning it on
-	// so for instance an args file with:
+	const size_t slotMask = m_LookupSlots.size() - 1;
+	for (size_t i = GetLookupSlotIndex(key);; i = (i + 1) & slotMask) {
+		const LookupSlot & rSlot = m_LookupSlots[i];
+		if (!rSlot.m_bUsed) {
+			return nullptr;
+		}
+		if (rSlot.m_Key == key) {
+			return &rSlot;
+		}
+	}
+}
+
+void CommandArgsMgr::AddLookupSlot(const uint32_t key, const CommandArgValue * pValue) {
+	// Called after the entry went into m_CommandArgsMap, grow by rebuilding from it
+	if (m_CommandArgsMap.size() * 2 > m_LookupSlots.size()) {
+		RebuildLookupSlots();
+		return;
+	}
+	const size_t slotMask = m_LookupSlots.size() - 1;
+	size_t i = GetLookupSlotIndex(key);
+	while (m_LookupSlots[i].m_bUsed && m_LookupSlots[i].m_Key != key) {
+		i = (i + 1) & slotMask;
+	}
+	m_LookupSlots[i].m_Key = key;
+	m_LookupSlots[i].m_bUsed = 1;
+	m_LookupSlots[i].m_pValue = pValue;
+}
+
+void CommandArgsMgr::RemoveLookupSlot(const uint32_t key) {
+	const LookupSlot * pSlot = FindLookupSlot(key);
+	if (pSlot == nullptr) {
+		return;
+	}
+	// Backward shift deletion, later slots of the same probe run move into the hole so no lookup stops early
+	const size_t slotMask = m_LookupSlots.size() - 1;
+	size_t holeIndex = static_cast<size_t>(pSlot - &m_LookupSlots[0]);
+	for (size_t i = (holeIndex + 1) & slotMask; m_LookupSlots[i].m_bUsed; i = (i + 1) & slotMask) {
+		const size_t homeIndex = GetLookupSlotIndex(m_LookupSlots[i].m_Key);
+		if (((i - homeIndex) & slotMask) >= ((i - holeIndex) & slotMask)) {
+			m_LookupSlots[holeIndex] = m_LookupSlots[i];
+			holeIndex = i;
+		}
+	}
+	LookupSlot sEmptySlot = { 0, 0, nullptr };
+	m_LookupSlots[holeIndex] = sEmptySlot;
+}
+
+void CommandArgsMgr::RebuildLookupSlots() {
+	size_t numSlots = 64;
+	uint32_t slotShift = 26;
+	while (m_CommandArgsMap.size() * 2 > numSlots) {
+		numSlots *= 2;
+		--slotShift;
+	}
+	LookupSlot sEmptySlot = { 0, 0, nullptr };
+	m_LookupSlots.assign(numSlots, sEmptySlot);
+	m_LookupSlotShift = slotShift;
+	for (std::unordered_map<uint32_t, CommandArgEntry>::const_iterator cit = m_CommandArgsMap.cbegin(); cit != m_CommandArgsMap.cend(); ++cit) {
+		const CommandArgVariable * pVariable = cit->second.GetVariable();
+		AddLookupSlot(cit->first, (pVariable != nullptr) ? &pVariable->GetValue() : nullptr);
+	}
+}
+
+static CommandArgValue * AllocateAlignedValues(const size_t numValues, void *& rpOutAllocation) {
+	const uintptr_t cacheLineSize = 64;
+	char * pAllocation = new char[numValues * sizeof(CommandArgValue) + cacheLineSize];
+	rpOutAllocation = pAllocation;
+	return reinterpret_cast<CommandArgValue *>((reinterpret_cast<uintptr_t>(pAllocation) + cacheLineSize - 1) & ~(cacheLineSize - 1));
+}
+
+CommandArgValue * CommandArgsMgr::AllocateVariableValue(CommandArgVariable * pVariable, const CommandArgVariableType::Type nType, const uint8_t flags) {
+	// Registration order already keeps the values of one translation unit together
+	if (m_ValueBlocks.empty() || m_ValueBlocks.back().m_NumValues == m_ValueBlocks.back().m_Capacity) {
+		VariableValueBlock sBlock;
+		sBlock.m_pValues = AllocateAlignedValues(ms_ValueBlockCapacity, sBlock.m_pAllocation);
+		sBlock.m_NumValues = 0;
+		sBlock.m_Capacity = ms_ValueBlockCapacity;
+		m_ValueBlocks.push_back(sBlock);
+	}
+	VariableValueBlock & rBlock = m_ValueBlocks.back();
+	CommandArgValue * pValue = new (&rBlock.m_pValues[rBlock.m_NumValues]) CommandArgValue(nType, flags);
+	++rBlock.m_NumValues;
+	m_StoredVariables.push_back(pVariable);
+	return pValue;
+}
+
+void CommandArgsMgr::UnregisterVariable(CommandArgVariable * pVariable) {
+	// Static variables go away in reverse registration order, so search from the back
+	std::vector<CommandArgVariable *>::reverse_iterator rit = std::find(m_StoredVariables.rbegin(), m_StoredVariables.rend(), pVariable);
+	if (rit != m_StoredVariables.rend()) {
+		m_StoredVariables.erase(std::next(rit).base());
+	}
+	// The value slot stays unused until the next PackVariableValues()
+	*pVariable->m_pValue = CommandArgValue();
+	if (pVariable->m_pOwnerMgr == nullptr) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(ms_ChildRegistriesMutex);
+	std::vector<CommandArgsMgr *> registries(1, this);
+	if (pVariable->m_pOwnerMgr != this) {
+		registries.push_back(pVariable->m_pOwnerMgr);
+	}
+	for (size_t i = 0; i < registries.size(); ++i) {
+		CommandArgsMgr * pMgr = registries[i];
+		std::unordered_map<uint32_t, CommandArgEntry>::iterator it = pMgr->m_CommandArgsMap.find(pVariable->m_Key);
+		if (it != pMgr->m_CommandArgsMap.end() && it->second.GetVariable() == pVariable) {
+			pMgr->m_CommandArgsMap.erase(it);
+			pMgr->RemoveLookupSlot(pVariable->m_Key);
+		}
+		for (size_t c = 0; c < pMgr->m_Children.size(); ++c) {
+			if (std::find(registries.begin(), registries.end(), pMgr->m_Children[c]) == registries.end()) {
+				registries.push_back(pMgr->m_Children[c]);
+			}
+		}
+	}
+}
+
+void CommandArgsMgr::ReleaseVariableValues() {
+	for (size_t b = 0; b < m_ValueBlocks.size(); ++b) {
+		for (size_t i = 0; i < m_ValueBlocks[b].m_NumValues; ++i) {
+			m_ValueBlocks[b].m_pValues[i].~CommandArgValue();
+		}
+		delete[] static_cast<char *>(m_ValueBlocks[b].m_pAllocation);
+	}
+	m_ValueBlocks.clear();
+}
+
+/// Appends a command line value so Execute sees it exactly as given
+/// Whitespace is kept so +SetPlayerPosition "1 2 3" still passes three tokens
+static void AppendEscapedArgValue(std::string & rOutCommand, const char * pValue) {
+	for (const char * pCur = pValue; *pCur; ++pCur) {
+		const char cCur = *pCur;
+		if (cCur == '"' || cCur == '\'' || cCur == '\\' || cCur == '#' || (cCur == '/' && pCur[1] == '/')) {
+			rOutCommand += '\\';
+		}
+		rOutCommand += cCur;
+	}
+}
+
+/// +name or --name, anything else on the command line is an args file
+static bool IsCommandLineNameArg(const char * pArg) {
+	return (pArg[0] == '+' && pArg[1] != '\0') || (pArg[0] == '-' && pArg[1] == '-' && pArg[2] != '\0');
+}
+
+/// Only true/false and integers, a bool +name followed by anything else is used as a flag
+static bool IsCommandLineBoolLiteral(const char * pArg) {
+	if (_strcmpi(pArg, "true") == 0 || _strcmpi(pArg, "false") == 0) {
+		return true;
+	}
+	if (*pArg == '-') {
+		++pArg;
+	}
+	if (*pArg == '\0') {
+		return false;
+	}
+	for (; *pArg; ++pArg) {
+		if (*pArg < '0' || *pArg > '9') {
+			return false;
+		}
+	}
+	return true;
+}
+
+/// FNV-1a, only used to skip comparing args files that can't be identical
+static uint64_t HashArgsFileContents(const char * pContents, const size_t contentsSize) {
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < contentsSize; ++i) {
+		hash ^= static_cast<uint8_t>(pContents[i]);
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+/// Collapses . and .. so include cycle detection sees one spelling per file
+static std::string NormalizeArgsFilePath(const std::string & rPath) {
+	std::vector<std::string> segments;
+	size_t segmentStart = 0;
+	while (segmentStart <= rPath.size()) {
+		size_t segmentEnd = rPath.find_first_of("/\\", segmentStart);
+		if (segmentEnd == std::string::npos) {
+			segmentEnd = rPath.size();
+		}
+		const std::string segment = rPath.substr(segmentStart, segmentEnd - segmentStart);
+		if (segment == "..") {
+			if (segments.empty() || segments.back() == "..") {
+				segments.push_back(segment);
+			} else if (!segments.back().empty() || segments.size() > 1) {
+				segments.pop_back();
+			}
+		} else if (segment != "." && (!segment.empty() || segments.empty())) {
+			// An empty first segment keeps the root of absolute paths
+			segments.push_back(segment);
+		}
+		segmentStart = segmentEnd + 1;
+	}
+	std::string normalizedPath;
+	for (size_t i = 0; i < segments.size(); ++i) {
+		if (i > 0) {
+			normalizedPath += '/';
+		}
+		normalizedPath += segments[i];
+	}
+	if (segments.size() == 1 && segments[0].empty()) {
+		return "/";
+	}
+	return normalizedPath.empty() ? std::string(".") : normalizedPath;
+}
+
+/// Relative include paths start from the directory of the file including them
+static std::string ResolveArgsFileIncludePath(const std::string & rIncludingFileName, const char * pIncludePath) {
+	const bool bIsAbsolute = pIncludePath[0] == '/' || pIncludePath[0] == '\\' || (pIncludePath[0] != '\0' && pIncludePath[1] == ':');
+	const size_t directoryEnd = rIncludingFileName.find_last_of("/\\");
+	if (bIsAbsolute || directoryEnd == std::string::npos) {
+		return NormalizeArgsFilePath(pIncludePath);
+	}
+	return NormalizeArgsFilePath(rIncludingFileName.substr(0, directoryEnd + 1) + pIncludePath);
+}
+
+std::shared_ptr<const CommandArgsFile> CommandArgsMgr::LoadArgsFile(const char * pFileName) {
+	std::ifstream inputFile(pFileName, std::ios::binary);
+	if (!inputFile) {
+		return std::shared_ptr<const CommandArgsFile>();
+	}
+	inputFile.seekg(0, std::ios::end);
+	const std::streamoff fileSize = inputFile.tellg();
+	inputFile.seekg(0, std::ios::beg);
+	if (fileSize < 0) {
+		return std::shared_ptr<const CommandArgsFile>();
+	}
+	std::shared_ptr<CommandArgsFile> pArgsFile = std::make_shared<CommandArgsFile>();
+	pArgsFile->m_pContents.reset(new char[static_cast<size_t>(fileSize) + 1]);
+	inputFile.read(pArgsFile->m_pContents.get(), fileSize);
+	pArgsFile->m_ContentsSize = static_cast<size_t>(inputFile.gcount());
+	pArgsFile->m_pContents[pArgsFile->m_ContentsSize] = '\0';
+	return SplitArgsFile(pArgsFile, true);
+}
+
+std::shared_ptr<const CommandArgsFile> CommandArgsMgr::LoadArgsString(const char * pContents) {
+	if (!pContents) {
+		return std::shared_ptr<const CommandArgsFile>();
+	}
+	std::shared_ptr<CommandArgsFile> pArgsFile = std::make_shared<CommandArgsFile>();
+	pArgsFile->m_ContentsSize = strlen(pContents);
+	pArgsFile->m_pContents.reset(new char[pArgsFile->m_ContentsSize + 1]);
+	memcpy(pArgsFile->m_pContents.get(), pContents, pArgsFile->m_ContentsSize + 1);
+	// Generated scripts are rarely run twice, keep them out of the process wide cache
+	return SplitArgsFile(pArgsFile, false);
+}
+
+std::shared_ptr<const CommandArgsFile> CommandArgsMgr::SplitArgsFile(const std::shared_ptr<CommandArgsFile> & pArgsFile, const bool bUseCache) {
+	// Terminate every line in place first, once terminated the contents alone decide the commands
+	char * pContents = pArgsFile->m_pContents.get();
+	char * pFileEnd = pContents + pArgsFile->m_ContentsSize;
+	const bool bHasNullBytes = memchr(pContents, '\0', pArgsFile->m_ContentsSize) != nullptr;
+	for (char * pLine = pContents; pLine < pFileEnd; ) {
+		char * pLineEnd = static_cast<char *>(memchr(pLine, '\n', pFileEnd - pLine));
+		if (!pLineEnd) {
+			pLineEnd = pFileEnd;
+		}
+		if (bHasNullBytes) {
+			// A null byte ends the line early, clear the rest so it can't show up as another command
+			char * pNull = static_cast<char *>(memchr(pLine, '\0', pLineEnd - pLine));
+			if (pNull != nullptr) {
+				memset(pNull, 0, pLineEnd - pNull);
+			}
+		}
+		*pLineEnd = '\0';
+		if (pLineEnd > pLine && pLineEnd[-1] == '\r') {
+			pLineEnd[-1] = '\0';
+		}
+		pLine = pLineEnd + 1;
+	}
+	pArgsFile->m_ContentsHash = HashArgsFileContents(pContents, pArgsFile->m_ContentsSize);
+	if (bUseCache) {
+		std::lock_guard<std::mutex> lock(ms_ArgsFileCacheMutex);
+		for (size_t i = 0; i < ms_ArgsFileCache.size(); ++i) {
+			const std::shared_ptr<const CommandArgsFile> pCachedFile = ms_ArgsFileCache[i];
+			if (pCachedFile->m_ContentsHash == pArgsFile->m_ContentsHash && pCachedFile->m_ContentsSize == pArgsFile->m_ContentsSize &&
+				memcmp(pCachedFile->m_pContents.get(), pContents, pArgsFile->m_ContentsSize) == 0) {
+				ms_ArgsFileCache.erase(ms_ArgsFileCache.begin() + i);
+				ms_ArgsFileCache.push_back(pCachedFile);
+				return pCachedFile;
+			}
+		}
+	}
+	// Split each line the same way Execute would
+	const uint32_t execKey = HashCommandLineArg("exec");
+	const uint32_t includeKey = HashCommandLineArg("include");
+	for (char * pLine = pContents; pLine < pFileEnd; pLine += strlen(pLine) + 1) {
+		if (*pLine != '\0' && !CommandArgsParser::IsCommentStart(pLine)) {
+			CommandArgsFileCommand sCommand;
+			char * pArgs = nullptr;
+			sCommand.m_Key = SplitCommand(pLine, pArgs, sCommand.m_bExpectsFlag);
+			sCommand.m_pArgs = pArgs;
+			sCommand.m_bIsInclude = !sCommand.m_bExpectsFlag && (sCommand.m_Key == execKey || sCommand.m_Key == includeKey);
+			pArgsFile->m_Commands.push_back(sCommand);
+		}
+	}
+	if (bUseCache) {
+		// Another thread may have split the same contents meanwhile, either copy will do
+		std::lock_guard<std::mutex> lock(ms_ArgsFileCacheMutex);
+		ms_ArgsFileCache.push_back(pArgsFile);
+		if (ms_ArgsFileCache.size() > ms_MaxCachedArgsFiles) {
+			ms_ArgsFileCache.erase(ms_ArgsFileCache.begin());
+		}
+	}
+	return pArgsFile;
+}
+
+void CommandArgsMgr::ClearArgsFileCache() {
+	std::lock_guard<std::mutex> lock(ms_ArgsFileCacheMutex);
+	ms_ArgsFileCache.clear();
+}
+
+bool CommandArgsMgr::ExecuteArgsFile(const std::string & rFileName, std::vector<std::string> & rIncludeStack) {
+	if (rIncludeStack.size() >= ms_MaxArgsFileIncludeDepth || std::find(rIncludeStack.begin(), rIncludeStack.end(), rFileName) != rIncludeStack.end()) {
+		return false;
+	}
+	std::shared_ptr<const CommandArgsFile> pArgsFile = LoadArgsFile(rFileName.c_str());
+	if (!pArgsFile) {
+		return false;
+	}
+	if (m_bLazyValueParsing && std::find(m_RetainedArgsFiles.begin(), m_RetainedArgsFiles.end(), pArgsFile) == m_RetainedArgsFiles.end()) {
+		m_RetainedArgsFiles.push_back(pArgsFile);
+	}
+	rIncludeStack.push_back(rFileName);
+	for (size_t i = 0; i < pArgsFile->m_Commands.size(); ++i) {
+		const CommandArgsFileCommand & rCommand = pArgsFile->m_Commands[i];
+		if (rCommand.m_bIsInclude) {
+			std::string includePath(strlen(rCommand.m_pArgs) + 1, '\0');
+			const size_t includePathLen = CommandArgsParser::UnquoteArgs(rCommand.m_pArgs, &includePath[0], includePath.size(), false);
+			includePath.resize(includePathLen);
+			ExecuteArgsFile(ResolveArgsFileIncludePath(rFileName, includePath.c_str()), rIncludeStack);
+			continue;
+		}
+		ExecuteSplitCommand(rCommand.m_Key, const_cast<char *>(rCommand.m_pArgs), rCommand.m_bExpectsFlag, m_bLazyValueParsing, true);
+	}
+	rIncludeStack.pop_back();
+	if (rIncludeStack.empty()) {
+		// Values from a previous load of an edited file were overwritten by now
+		ReleaseUnusedArgsFiles();
+	}
+	return true;
+}
+
+void CommandArgsMgr::ReleaseUnusedArgsFiles() {
+	if (m_RetainedArgsFiles.empty()) {
+		return;
+	}
+	std::vector<const char *> lazyTexts;
+	for (std::unordered_map<uint32_t, CommandArgValue>::const_iterator cit = m_LocalValues.cbegin(); cit != m_LocalValues.cend(); ++cit) {
+		if (const char * pLazyText = cit->second.GetLazyText()) {
+			lazyTexts.push_back(pLazyText);
+		}
+	}
+	for (std::unordered_map<uint32_t, CommandArgEntry>::const_iterator cit = m_CommandArgsMap.cbegin(); cit != m_CommandArgsMap.cend(); ++cit) {
+		const CommandArgVariable * pVariable = cit->second.GetVariable();
+		if (pVariable != nullptr && pVariable->GetValue().GetLazyText() != nullptr) {
+			lazyTexts.push_back(pVariable->GetValue().GetLazyText());
+		}
+	}
+	std::sort(lazyTexts.begin(), lazyTexts.end(), std::less<const char *>());
+	for (size_t i = 0; i < m_RetainedArgsFiles.size();) {
+		const char * pContents = m_RetainedArgsFiles[i]->m_pContents.get();
+		std::vector<const char *>::const_iterator cit = std::lower_bound(lazyTexts.cbegin(), lazyTexts.cend(), pContents, std::less<const char *>());
+		if (cit != lazyTexts.cend() && std::less<const char *>()(*cit, pContents + m_RetainedArgsFiles[i]->m_ContentsSize)) {
+			++i;
+		} else {
+			m_RetainedArgsFiles[i] = std::move(m_RetainedArgsFiles.back());
+			m_RetainedArgsFiles.pop_back();
+		}
+	}
+}
+
+void CommandArgsMgr::AppendEnvironmentCommands(std::vector<std::string> & rOutCommands) const {
+	if (!m_pEnvironmentPrefix || !(*m_pEnvironmentPrefix) || !COMMAND_ARGS_ENVIRONMENT) {
+		return;
+	}
+	const size_t prefixLen = strlen(m_pEnvironmentPrefix);
+	for (char ** ppCurVariable = COMMAND_ARGS_ENVIRONMENT; *ppCurVariable != nullptr; ++ppCurVariable) {
+		// NAME=value, the prefix is stripped and the rest of the name is the command
+		const char * pCurVariable = *ppCurVariable;
+		if (strncmp(pCurVariable, m_pEnvironmentPrefix, prefixLen) != 0) {
+			continue;
+		}
+		const char * pName = pCurVariable + prefixLen;
+		const char * pEquals = strchr(pName, '=');
+		if (!pEquals || pEquals == pName) {
+			continue;
+		}
+		std::string command(pName, pEquals);
+		command += ' ';
+		AppendEscapedArgValue(command, pEquals + 1);
+		rOutCommands.push_back(command);
+	}
+}
+
+bool CommandArgsMgr::CommandLineArgTakesValue(const int argc, char * argv[], const int nameIndex) const {
+	if (argv[nameIndex][0] != '+' || nameIndex + 1 >= argc || IsCommandLineNameArg(argv[nameIndex + 1])) {
+		return false;
+	}
+	// Keeps +g_EnableExtraLogging config.txt from swallowing the args file
+	const CommandArgEntry * pEntry = FindCommandArgEntry(HashCommandLineArg(argv[nameIndex] + 1));
+	const CommandArgVariable * pVariable = (pEntry != nullptr) ? pEntry->GetVariable() : nullptr;
+	if (pVariable != nullptr && pVariable->GetType() == CommandArgVariableType::Boolean) {
+		return IsCommandLineBoolLiteral(argv[nameIndex + 1]);
+	}
+	return true;
+}
+
+void CommandArgsMgr::AppendCommandLineCommands(const int argc, char * argv[], std::vector<std::string> & rOutCommands) const {
+	for (int i = 1; i < argc; ++i) {
+		const char * pArg = argv[i];
+		if (!IsCommandLineNameArg(pArg)) {
+			continue;
+		}
+		if (pArg[0] == '-') {
+			// --name=value or --name for a flag
+			const char * pName = pArg + 2;
+			const char * pEquals = strchr(pName, '=');
+			if (!pEquals) {
+				rOutCommands.push_back(pName);
+				continue;
+			}
+			std::string command(pName, pEquals);
+			command += ' ';
+			AppendEscapedArgValue(command, pEquals + 1);
+			rOutCommands.push_back(command);
+		} else {
+			// +name value, the value is optional for flags
+			std::string command(pArg + 1);
+			if (CommandLineArgTakesValue(argc, argv, i)) {
+				command += ' ';
+				AppendEscapedArgValue(command, argv[++i]);
+			}
+			rOutCommands.push_back(command);
+		}
+	}
+}
+
+void CommandArgsMgr::SetupAllCommandArgs(const int argc, char * argv[]) {
+	// Args files are the lowest precedence so they run as they are found,
+	// the other sources are gathered so they apply in order no matter where they appear in argv
+	std::vector<std::string> commands;
+	std::vector<std::string> includeStack;
+	for (int i = 1; i < argc; ++i) {
+		const char * pArg = argv[i];
+		if (IsCommandLineNameArg(pArg)) {
+			// Skip the value belonging to +name so it isn't mistaken for an args file
+			if (CommandLineArgTakesValue(argc, argv, i)) {
+				++i;
+			}
+			continue;
+		}
+		ExecuteArgsFile(NormalizeArgsFilePath(pArg), includeStack);
+	}
+	AppendEnvironmentCommands(commands);
+	AppendCommandLineCommands(argc, argv, commands);
+	for (size_t i = 0; i < commands.size(); ++i) {
+		Execute(commands[i].c_str());
+	}
+}
+
+int CommandArgsMgr::Execute(const char * pCommand) {
+	return ExecuteInternal(pCommand, false);
+}
+
+uint32_t CommandArgsMgr::SplitCommand(const char * pCommand, char *& rpOutArgs, bool & rbOutExpectsFlag) {
+	// A valid argument is just giving the name of a flag which implies turning it on
+	// so for instance an args file with:
 	// g_enableVerboseLogging
 	// would be the same as 
 	// g_enableVerboseLogging 1
 	const char * pSpaceCharPtr = FindFirstWhitespaceCharacterAfterFirstToken(pCommand);
 	uint32_t key = 0;
-	bool expectsFlag = false;
+	rbOutExpectsFlag = false;
 	if (!pSpaceCharPtr || !(*pSpaceCharPtr)) {
 		key = HashCommandLineArg(pCommand);
-		expectsFlag = true;
+		rbOutExpectsFlag = true;
 	} else {
 		key = HashCommandLineArg_StartEnd(pCommand, pSpaceCharPtr);
 	}
+	rpOutArgs = FindFirstNonWhitespaceCharacter(pSpaceCharPtr);
+	if (!rbOutExpectsFlag && (*rpOutArgs == '\0' || CommandArgsParser::IsCommentStart(rpOutArgs))) {
+		// Only whitespace or a comment after the name is still just the flag
+		rbOutExpectsFlag = true;
+	}
+	return key;
+}
+
+int CommandArgsMgr::ExecuteInternal(const char * pCommand, const bool bDeferVariables) {
+	if (!pCommand || CommandArgsParser::IsCommentStart(pCommand)) {
+		return 0;
+	}
+	char * pArgRHSString = nullptr;
+	bool expectsFlag = false;
+	const uint32_t key = SplitCommand(pCommand, pArgRHSString, expectsFlag);
+	return ExecuteSplitCommand(key, pArgRHSString, expectsFlag, bDeferVariables, false);
+}
+
+int CommandArgsMgr::ExecuteSplitCommand(const uint32_t key, char * pArgRHSString, const bool bExpectsFlag, const bool bDeferVariables, const bool bArgsAreShared) {
 	// Expect variables/commands to be initliazed already
-	std::unordered_map<uint32_t, CommandArgEntry>::iterator it;
-	if (!FindCommandArgEntry(it, key)) {
+	const CommandArgEntry * pEntry = FindCommandArgEntry(key);
+	if (!pEntry) {
 		return 0;
 	}
-	char * pArgRHSString = FindFirstNonWhitespaceCharacter(pSpaceCharPtr);
-	const CommandArgEntry & rEntry = it->second;
+	const CommandArgEntry & rEntry = *pEntry;
 	const unsigned int entryType = rEntry.GetType();
 	if (entryType == CommandArgEntryType::Function) {
 		// Invoke the function pointer
@@ -535,8 +1680,15 @@ int CommandArgsMgr::Execute(const char * pCommand) {
 		if (!pFunc) {
 			return 0;
 		}
+		// The parser tokenizes in place, shared args file lines get a private copy
+		std::string argsCopy;
+		if (bArgsAreShared) {
+			argsCopy = pArgRHSString;
+			pArgRHSString = &argsCopy[0];
+		}
 		CommandArgsParser argsParser;
 		argsParser.InitWithArgs(pArgRHSString);
+		argsParser.SetCommandArgsMgr(this);
 		return (*pFunc)(argsParser);
 	} else if (entryType == CommandArgEntryType::Variable) {
 		// Parse the variable and set the tagged variant appropriately
@@ -545,46 +1697,403 @@ int CommandArgsMgr::Execute(const char * pCommand) {
 			return 0;
 		}
 		const CommandArgVariableType::Type nType = pCommandArgVariable->GetType();
-		if (expectsFlag) {
+		CommandArgValue newValue(nType);
+		if (bExpectsFlag) {
 			if (nType != CommandArgVariableType::Boolean) {
 				return 0;
 			}
-			pCommandArgVariable->SetBool(true);
-			return 1;
+			newValue.SetBool(true);
+		} else if (bDeferVariables) {
+			// pCommand is retained by the caller, parsing waits for the first read
+			newValue.SetLazyValue(pArgRHSString);
+		} else if (!newValue.ParseFromString(pArgRHSString)) {
+			return 0;
+		}
+		// Variables owned by this registry are written directly
+		// Everything else keeps a local value so the shared definition is untouched, even when
+		// this registry registered the shared variable itself
+		if (pCommandArgVariable->m_pOwnerMgr == this) {
+			pCommandArgVariable->SetValue(std::move(newValue));
 		} else {
-			if (nType == CommandArgVariableType::Boolean) {
-				bool boolToSet = false;
-				if (CommandArgsParser::Parse_Bool(pArgRHSString, boolToSet)) {
-					pCommandArgVariable->SetBool(boolToSet);
-					return 1;
+			const uint32_t variableIndex = pCommandArgVariable->GetIndex();
+			const CommandArgValue * pCurValue = FindValueForKey(key);
+			if (pCurValue == nullptr || !pCurValue->Equals(newValue)) {
+				MarkVariableDirty(variableIndex);
+			}
+			m_LocalValues[key] = std::move(newValue);
+			if (variableIndex != CommandArgVariable::ms_InvalidIndex) {
+				if (variableIndex / 64 >= m_LocalValueBits.size()) {
+					m_LocalValueBits.resize(variableIndex / 64 + 1, 0);
 				}
-			} else if (nType == CommandArgVariableType::Integer) {
-				int intToSet = 0;
-				if (CommandArgsParser::Parse_Integer(pArgRHSString, intToSet)) {
-					pCommandArgVariable->SetInt(intToSet);
-					return 1;
+				m_LocalValueBits[variableIndex / 64] |= (uint64_t(1) << (variableIndex % 64));
+			}
+		}
+		return 1;
+	}
+	return 0;
+}
+
+void CommandArgsMgr::ClearLocalValues() {
+	// Every cleared value falls back to the parent's so treat them all as changed
+	for (std::unordered_map<uint32_t, CommandArgValue>::const_iterator cit = m_LocalValues.cbegin(); cit != m_LocalValues.cend(); ++cit) {
+		MarkKeyDirty(cit->first);
+	}
+	m_LocalValues.clear();
+	m_LocalValueBits.clear();
+	ReleaseUnusedArgsFiles();
+}
+
+uint32_t CommandArgsMgr::SubscribeToChanges(const uint32_t key, const CommandArgChangeFunc pFunc, void * pUserData /*= nullptr*/) {
+	if (!pFunc) { return 0; }
+	const CommandArgEntry * pEntry = FindCommandArgEntry(key);
+	if (!pEntry || pEntry->GetType() != CommandArgEntryType::Variable) {
+		return 0;
+	}
+	const CommandArgVariable * pVariable = pEntry->GetVariable();
+	if (!pVariable || pVariable->GetIndex() == CommandArgVariable::ms_InvalidIndex) {
+		return 0;
+	}
+	const uint32_t variableIndex = pVariable->GetIndex();
+	if (variableIndex >= m_ChangeSubscriptions.size()) {
+		m_ChangeSubscriptions.resize(variableIndex + 1);
+		m_SeenInheritedEpochs.resize(variableIndex + 1, 0);
+	}
+	if (m_ChangeSubscriptions[variableIndex].empty()) {
+		// Only parent changes made from now on are news to this subscriber
+		m_SubscribedVariables.push_back(variableIndex);
+		m_SeenInheritedEpochs[variableIndex] = GetInheritedChangeEpoch(variableIndex);
+	}
+	ChangeSubscription sSubscription;
+	sSubscription.m_Handle = m_NextSubscriptionHandle++;
+	sSubscription.m_Key = key;
+	sSubscription.m_pFunc = pFunc;
+	sSubscription.m_pUserData = pUserData;
+	m_ChangeSubscriptions[variableIndex].push_back(sSubscription);
+	return sSubscription.m_Handle;
+}
+
+void CommandArgsMgr::UnsubscribeFromChanges(const uint32_t subscriptionHandle) {
+	for (size_t i = 0; i < m_ChangeSubscriptions.size(); ++i) {
+		std::vector<ChangeSubscription> & rSubscriptions = m_ChangeSubscriptions[i];
+		for (size_t s = 0; s < rSubscriptions.size(); ++s) {
+			if (rSubscriptions[s].m_Handle == subscriptionHandle) {
+				// Might be inside DispatchChanges() so only clear it, the list is compacted afterwards
+				rSubscriptions[s].m_pFunc = nullptr;
+				if (m_bIsDispatching) {
+					m_bHasUnsubscribedWhileDispatching = true;
+				} else {
+					rSubscriptions.erase(rSubscriptions.begin() + s);
+					if (rSubscriptions.empty()) {
+						m_SubscribedVariables.erase(std::find(m_SubscribedVariables.begin(), m_SubscribedVariables.end(), static_cast<uint32_t>(i)));
+					}
 				}
-			} else if (nType == CommandArgVariableType::Float) {
-				float floatToSet = 0.0f;
-				if (CommandArgsParser::Parse_Float(pArgRHSString, floatToSet)) {
-					pCommandArgVariable->SetFloat(floatToSet);
-					return 1;
+				return;
+			}
+		}
+	}
+}
+
+void CommandArgsMgr::MarkVariableDirty(const uint32_t variableIndex) {
+	if (variableIndex == CommandArgVariable::ms_InvalidIndex) {
+		return;
+	}
+	const size_t wordIndex = variableIndex / 64;
+	if (wordIndex >= m_DirtyBits.size()) {
+		m_DirtyBits.resize(wordIndex + 1, 0);
+	}
+	m_DirtyBits[wordIndex] |= uint64_t(1) << (variableIndex % 64);
+	// Children pick the change up from here in their own DispatchChanges()
+	if (variableIndex >= m_ChangeEpochs.size()) {
+		m_ChangeEpochs.resize(variableIndex + 1, 0);
+	}
+	m_ChangeEpochs[variableIndex] = ms_ChangeEpoch.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+uint64_t CommandArgsMgr::GetInheritedChangeEpoch(const uint32_t variableIndex) const {
+	// Newest change along the parent chain, stopping at the first registry holding its own value
+	const size_t wordIndex = variableIndex / 64;
+	const uint64_t variableBit = uint64_t(1) << (variableIndex % 64);
+	uint64_t newestEpoch = 0;
+	for (const CommandArgsMgr * pMgr = this; pMgr != nullptr; pMgr = pMgr->m_pParent) {
+		if (pMgr != this && variableIndex < pMgr->m_ChangeEpochs.size()) {
+			newestEpoch = std::max(newestEpoch, pMgr->m_ChangeEpochs[variableIndex]);
+		}
+		if (wordIndex < pMgr->m_LocalValueBits.size() && (pMgr->m_LocalValueBits[wordIndex] & variableBit) != 0) {
+			break;
+		}
+	}
+	return newestEpoch;
+}
+
+void CommandArgsMgr::MarkKeyDirty(const uint32_t key) {
+	const CommandArgEntry * pEntry = FindCommandArgEntry(key);
+	if (pEntry != nullptr && pEntry->GetVariable() != nullptr) {
+		MarkVariableDirty(pEntry->GetVariable()->GetIndex());
+	}
+}
+
+void CommandArgsMgr::PackVariableValues(const uint32_t * pHotKeys /*= nullptr*/, const size_t numHotKeys /*= 0*/) {
+	std::vector<CommandArgVariable *> variables;
+	variables.reserve(m_StoredVariables.size());
+	for (size_t i = 0; i < numHotKeys; ++i) {
+		std::unordered_map<uint32_t, CommandArgEntry>::const_iterator cit = m_CommandArgsMap.find(pHotKeys[i]);
+		if (cit == m_CommandArgsMap.cend() || cit->second.GetType() != CommandArgEntryType::Variable) {
+			continue;
+		}
+		CommandArgVariable * pVariable = cit->second.GetVariable();
+		if (std::find(m_StoredVariables.begin(), m_StoredVariables.end(), pVariable) != m_StoredVariables.end() &&
+			std::find(variables.begin(), variables.end(), pVariable) == variables.end()) {
+			variables.push_back(pVariable);
+		}
+	}
+	const size_t numHotVariables = variables.size();
+	for (size_t i = 0; i < m_StoredVariables.size(); ++i) {
+		CommandArgVariable * pVariable = m_StoredVariables[i];
+		if (std::find(variables.begin(), variables.begin() + numHotVariables, pVariable) == variables.begin() + numHotVariables) {
+			variables.push_back(pVariable);
+		}
+	}
+	if (variables.empty()) {
+		return;
+	}
+
+	VariableValueBlock sPackedBlock;
+	sPackedBlock.m_pValues = AllocateAlignedValues(variables.size(), sPackedBlock.m_pAllocation);
+	sPackedBlock.m_NumValues = sPackedBlock.m_Capacity = variables.size();
+	for (size_t i = 0; i < variables.size(); ++i) {
+		new (&sPackedBlock.m_pValues[i]) CommandArgValue(std::move(*variables[i]->m_pValue));
+		variables[i]->m_pValue = &sPackedBlock.m_pValues[i];
+	}
+	ReleaseVariableValues();
+	m_ValueBlocks.push_back(sPackedBlock);
+	m_StoredVariables.swap(variables);
+
+	// Lookup slots point at the old values, children may have registered these variables as well
+	std::lock_guard<std::mutex> lock(ms_ChildRegistriesMutex);
+	std::vector<CommandArgsMgr *> registries(1, this);
+	for (size_t i = 0; i < registries.size(); ++i) {
+		registries[i]->RebuildLookupSlots();
+		registries.insert(registries.end(), registries[i]->m_Children.begin(), registries[i]->m_Children.end());
+	}
+}
+
+uint32_t CommandArgsMgr::DispatchChanges() {
+	// Nested dispatches from inside a callback are ignored, their changes go out next time
+	if (m_bIsDispatching) {
+		return 0;
+	}
+	m_bIsDispatching = true;
+	// Parents never touch their children, so inherited changes are found by comparing epochs
+	// That's only needed when some registry changed something since the last check
+	const uint64_t changeEpoch = ms_ChangeEpoch.load(std::memory_order_relaxed);
+	if (m_pParent != nullptr && changeEpoch != m_LastDispatchEpoch) {
+		m_LastDispatchEpoch = changeEpoch;
+		for (size_t i = 0; i < m_SubscribedVariables.size(); ++i) {
+			const uint32_t variableIndex = m_SubscribedVariables[i];
+			const uint64_t inheritedEpoch = GetInheritedChangeEpoch(variableIndex);
+			if (inheritedEpoch > m_SeenInheritedEpochs[variableIndex]) {
+				m_SeenInheritedEpochs[variableIndex] = inheritedEpoch;
+				if (variableIndex / 64 >= m_DirtyBits.size()) {
+					m_DirtyBits.resize(variableIndex / 64 + 1, 0);
 				}
-			} else if (nType == CommandArgVariableType::CString) {
-				size_t stringLen = strlen(pArgRHSString);
-				size_t stringSize = stringLen + 1;
-				char * deepStringCopy = new char[stringSize];
-				strcpy_s(deepStringCopy, stringSize, pArgRHSString);
-				pCommandArgVariable->SetCString(deepStringCopy);
-				pCommandArgVariable->SetFlags(pCommandArgVariable->GetFlags() | CommandArgVariableFlags::OwnsCString);
-				return 1;
+				m_DirtyBits[variableIndex / 64] |= uint64_t(1) << (variableIndex % 64);
 			}
 		}
 	}
-	return 0;
+	uint32_t numNotifications = 0;
+	for (size_t wordIndex = 0; wordIndex < m_DirtyBits.size(); ++wordIndex) {
+		// Clear the word before notifying so changes made by the callbacks are picked up next dispatch
+		uint64_t dirtyWord = m_DirtyBits[wordIndex];
+		m_DirtyBits[wordIndex] = 0;
+		while (dirtyWord != 0) {
+			const size_t variableIndex = wordIndex * 64 + CountTrailingZeros64(dirtyWord);
+			dirtyWord &= dirtyWord - 1;
+			if (variableIndex >= m_ChangeSubscriptions.size()) {
+				continue;
+			}
+			// Index based since callbacks are allowed to subscribe
+			for (size_t s = 0; s < m_ChangeSubscriptions[variableIndex].size(); ++s) {
+				const ChangeSubscription sSubscription = m_ChangeSubscriptions[variableIndex][s];
+				if (sSubscription.m_pFunc != nullptr) {
+					(*sSubscription.m_pFunc)(*this, sSubscription.m_Key, sSubscription.m_pUserData);
+					++numNotifications;
+				}
+			}
+		}
+	}
+	// Drop anything that was unsubscribed while dispatching
+	for (size_t i = 0; m_bHasUnsubscribedWhileDispatching && i < m_SubscribedVariables.size();) {
+		std::vector<ChangeSubscription> & rSubscriptions = m_ChangeSubscriptions[m_SubscribedVariables[i]];
+		for (size_t s = 0; s < rSubscriptions.size();) {
+			if (rSubscriptions[s].m_pFunc == nullptr) {
+				rSubscriptions.erase(rSubscriptions.begin() + s);
+			} else {
+				++s;
+			}
+		}
+		if (rSubscriptions.empty()) {
+			m_SubscribedVariables[i] = m_SubscribedVariables.back();
+			m_SubscribedVariables.pop_back();
+		} else {
+			++i;
+		}
+	}
+	m_bHasUnsubscribedWhileDispatching = false;
+	m_bIsDispatching = false;
+	return numNotifications;
+}
+
+const CommandArgEntry * CommandArgsMgr::FindCommandArgEntry(const uint32_t key) const {
+	for (const CommandArgsMgr * pMgr = this; pMgr != nullptr; pMgr = pMgr->m_pParent) {
+		std::unordered_map<uint32_t, CommandArgEntry>::const_iterator cit = pMgr->m_CommandArgsMap.find(key);
+		if (cit != pMgr->m_CommandArgsMap.cend()) {
+			return &cit->second;
+		}
+	}
+	return nullptr;
+}
+
+const CommandArgValue * CommandArgsMgr::FindValueForKey(const uint32_t key) const {
+	// Walk towards the base table, at each level a local override wins over that level's own variables
+	for (const CommandArgsMgr * pMgr = this; pMgr != nullptr; pMgr = pMgr->m_pParent) {
+		std::unordered_map<uint32_t, CommandArgValue>::const_iterator vit = pMgr->m_LocalValues.find(key);
+		if (vit != pMgr->m_LocalValues.cend()) {
+			return &vit->second;
+		}
+		const LookupSlot * pSlot = pMgr->FindLookupSlot(key);
+		if (pSlot != nullptr) {
+			return pSlot->m_pValue;
+		}
+	}
+	return nullptr;
+}
+
+static const uint32_t s_ScriptWaitKey = CommandArgsMgr::HashCommandLineArg("wait");
+static const uint32_t s_ScriptWaitMsKey = CommandArgsMgr::HashCommandLineArg("wait_ms");
+
+static int64_t GetScriptTimeMicroseconds() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/// First token of a wait directive, falls back to the given count when missing or invalid
+static int ParseScriptWaitCount(const CommandArgsFileCommand & rCommand, const int defaultCount) {
+	if (rCommand.m_bExpectsFlag) {
+		return defaultCount;
+	}
+	char countToken[32];
+	CommandArgsParser::UnquoteArgs(rCommand.m_pArgs, countToken, sizeof(countToken), true);
+	int count = defaultCount;
+	if (!CommandArgsParser::Parse_Integer(countToken, count)) {
+		return defaultCount;
+	}
+	return count;
+}
+
+CommandArgsScriptExecutor::CommandArgsScriptExecutor(CommandArgsMgr & rMgr) : m_pMgr(&rMgr), m_WaitUntilMicroseconds(0), m_FramesToWait(0) {
+
+}
+
+bool CommandArgsScriptExecutor::LoadFile(const char * pFileName) {
+	Stop();
+	if (!pFileName) {
+		return false;
+	}
+	const std::string fileName = NormalizeArgsFilePath(pFileName);
+	return PushScript(CommandArgsMgr::LoadArgsFile(fileName.c_str()), fileName);
+}
+
+bool CommandArgsScriptExecutor::LoadString(const char * pScript) {
+	Stop();
+	return PushScript(CommandArgsMgr::LoadArgsString(pScript), std::string());
+}
+
+void CommandArgsScriptExecutor::Stop() {
+	m_Frames.clear();
+	m_WaitUntilMicroseconds = 0;
+	m_FramesToWait = 0;
+}
+
+bool CommandArgsScriptExecutor::PushScript(const std::shared_ptr<const CommandArgsFile> & pScript, const std::string & rFileName) {
+	if (!pScript || m_Frames.size() >= CommandArgsMgr::ms_MaxArgsFileIncludeDepth) {
+		return false;
+	}
+	// Same cycle rule as args files, a file already being run is skipped
+	for (size_t i = 0; i < m_Frames.size(); ++i) {
+		if (!rFileName.empty() && m_Frames[i].m_FileName == rFileName) {
+			return false;
+		}
+	}
+	ScriptFrame sFrame;
+	sFrame.m_pScript = pScript;
+	sFrame.m_FileName = rFileName;
+	sFrame.m_NextCommand = 0;
+	m_Frames.push_back(sFrame);
+	return true;
 }
 
-bool CommandArgsMgr::FindCommandArgEntry(std::unordered_map<uint32_t, CommandArgEntry>::iterator & inOutIterator, const uint32_t key) {
-	inOutIterator = m_CommandArgsMap.find(key);
-	return inOutIterator != m_CommandArgsMap.end();
+CommandArgsScriptState::Type CommandArgsScriptExecutor::Tick(const uint32_t maxCommands, const uint32_t maxMicroseconds /*= 0*/) {
+	if (m_FramesToWait > 0) {
+		--m_FramesToWait;
+		return CommandArgsScriptState::Waiting;
+	}
+	const int64_t tickStartMicroseconds = GetScriptTimeMicroseconds();
+	if (m_WaitUntilMicroseconds > tickStartMicroseconds) {
+		return CommandArgsScriptState::Waiting;
+	}
+	m_WaitUntilMicroseconds = 0;
+	uint32_t numExecuted = 0;
+	while (!m_Frames.empty()) {
+		ScriptFrame & rFrame = m_Frames.back();
+		if (rFrame.m_NextCommand >= rFrame.m_pScript->m_Commands.size()) {
+			m_Frames.pop_back();
+			continue;
+		}
+		if (numExecuted > 0) {
+			if (maxCommands != 0 && numExecuted >= maxCommands) {
+				return CommandArgsScriptState::Running;
+			}
+			if (maxMicroseconds != 0 && GetScriptTimeMicroseconds() - tickStartMicroseconds >= maxMicroseconds) {
+				return CommandArgsScriptState::Running;
+			}
+		}
+		// Hold the script itself since an exec pushing a frame can move rFrame
+		const std::shared_ptr<const CommandArgsFile> pScript = rFrame.m_pScript;
+		const std::string & rFileName = rFrame.m_FileName;
+		const CommandArgsFileCommand & rCommand = pScript->m_Commands[rFrame.m_NextCommand++];
+		++numExecuted;
+		if (rCommand.m_bIsInclude) {
+			std::string includePath(strlen(rCommand.m_pArgs) + 1, '\0');
+			const size_t includePathLen = CommandArgsParser::UnquoteArgs(rCommand.m_pArgs, &includePath[0], includePath.size(), false);
+			includePath.resize(includePathLen);
+			const std::string resolvedPath = ResolveArgsFileIncludePath(rFileName, includePath.c_str());
+			PushScript(CommandArgsMgr::LoadArgsFile(resolvedPath.c_str()), resolvedPath);
+		} else if (rCommand.m_Key == s_ScriptWaitKey) {
+			const int numFrames = ParseScriptWaitCount(rCommand, 1);
+			if (numFrames > 0) {
+				m_FramesToWait = static_cast<uint32_t>(numFrames);
+				return CommandArgsScriptState::Waiting;
+			}
+		} else if (rCommand.m_Key == s_ScriptWaitMsKey) {
+			const int numMilliseconds = ParseScriptWaitCount(rCommand, 0);
+			if (numMilliseconds > 0) {
+				m_WaitUntilMicroseconds = GetScriptTimeMicroseconds() + static_cast<int64_t>(numMilliseconds) * 1000;
+				return CommandArgsScriptState::Waiting;
+			}
+		} else {
+			m_pMgr->ExecuteSplitCommand(rCommand.m_Key, const_cast<char *>(rCommand.m_pArgs), rCommand.m_bExpectsFlag, false, true);
+		}
+	}
+	return CommandArgsScriptState::Finished;
 }
+
+CommandArgsScriptState::Type CommandArgsScriptExecutor::GetState() const {
+	if (m_FramesToWait > 0 || m_WaitUntilMicroseconds > GetScriptTimeMicroseconds()) {
+		return CommandArgsScriptState::Waiting;
+	}
+	for (size_t i = 0; i < m_Frames.size(); ++i) {
+		if (m_Frames[i].m_NextCommand < m_Frames[i].m_pScript->m_Commands.size()) {
+			return CommandArgsScriptState::Running;
+		}
+	}
+	return CommandArgsScriptState::Finished;
+}
\ No newline at end of file
@@ -2,8 +2,15 @@
 #define COMMAND_ARGS_PARSER_H
 
 #include <unordered_map>
+#include <vector>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <mutex>
 #include <cstdint>
 
+class CommandArgsMgr;
+
 /// Tagged variant variable type
 namespace CommandArgVariableType {
 	enum Type {
@@ -18,26 +25,36 @@ namespace CommandArgVariableType {
 /// Flags for the CommandArgVariable class 
 namespace CommandArgVariableFlags {
 	enum Flags {
-		OwnsCString = 1
+		OwnsCString = 1,
+		InlineCString = 2	// Short cstring copies live inside the value itself, never combined with OwnsCString
 	};
 }
 
-/// Tagged variant class used for command line variables
+/// Parse state of a CommandArgValue loaded with SetLazyValue()
+namespace CommandArgValueLazyState {
+	enum State {
+		Resolved,	// m_Data holds the typed value
+		Pending,	// m_Data holds the unparsed right hand side of the command
+		Resolving	// Another thread is parsing it right now
+	};
+}
+
+/// Tagged variant storage for a single command line value
 /// Might own the cstring if OwnsCString flag is set
-/// Must be placed in static memory - will register the command on construction
-class CommandArgVariable {
+/// Copied cstrings shorter than ms_InlineCStringCapacity are stored inline instead of on the heap
+/// Used by CommandArgVariable for its own value and by CommandArgsMgr for per-registry overrides
+/// A lazy value only keeps a pointer to its unparsed text, the first Get*() call parses it exactly once
+/// even if several threads read it at the same time
+class CommandArgValue {
 public:
 
-	CommandArgVariable() = delete;
-	~CommandArgVariable();
-	CommandArgVariable(const char * pVariableName, const CommandArgVariableType::Type nType, const int defaultIntValue, const uint8_t flags = 0);
-	CommandArgVariable(const char * pVariableName, const CommandArgVariableType::Type nType, const bool defaultBoolValue, const uint8_t flags = 0);
-	CommandArgVariable(const char * pVariableName, const CommandArgVariableType::Type nType, const float defaultFloatValue, const uint8_t flags = 0);
-	CommandArgVariable(const char * pVariableName, const CommandArgVariableType::Type nType, const char * defaultCStringValue, const uint8_t flags = 0);
-	CommandArgVariable(const uint32_t variableHash, const CommandArgVariableType::Type nType, const int defaultIntValue, const uint8_t flags = 0);
-	CommandArgVariable(const uint32_t variableHash, const CommandArgVariableType::Type nType, const bool defaultBoolValue, const uint8_t flags = 0);
-	CommandArgVariable(const uint32_t variableHash, const CommandArgVariableType::Type nType, const float defaultFloatValue, const uint8_t flags = 0);
-	CommandArgVariable(const uint32_t variableHash, const CommandArgVariableType::Type nType, const char * defaultCStringValue, const uint8_t flags = 0);
+	CommandArgValue();
+	explicit CommandArgValue(const CommandArgVariableType::Type nType, const uint8_t flags = 0);
+	CommandArgValue(const CommandArgValue &) = delete;
+	CommandArgValue(CommandArgValue && rOther);
+	~CommandArgValue();
+	CommandArgValue & operator=(const CommandArgValue &) = delete;
+	CommandArgValue & operator=(CommandArgValue && rOther);
 
 	int GetInt() const;
 	float GetFloat() const;
@@ -47,19 +64,91 @@ public:
 	void SetFloat(const float f);
 	void SetBool(const bool b);
 	void SetCString(const char * pString);
+	void CopyCString(const char * pString);
+	bool ParseFromString(const char * pString);
+	void SetLazyValue(const char * pRawString);
+	bool IsLazyPending() const { return m_LazyState.load(std::memory_order_acquire) != CommandArgValueLazyState::Resolved; }
+	/// Unparsed text of a lazy value, nullptr once it has been parsed or overwritten
+	const char * GetLazyText() const { return IsLazyPending() ? m_Data.m_AsCString : nullptr; }
+	bool Equals(const CommandArgValue & rOther) const;
 	CommandArgVariableType::Type GetType() const { return static_cast<CommandArgVariableType::Type>(m_Type); }
 	void SetFlags(const uint8_t flags) { m_Flags = flags; }
 	uint8_t GetFlags() const { return m_Flags; }
 
+	static const size_t ms_InlineCStringCapacity = 24;	// Including the null terminator
+
 private:
-	union {
+	const char * GetCStringPtr() const { return (m_Flags & CommandArgVariableFlags::InlineCString) ? m_Data.m_AsInlineCString : m_Data.m_AsCString; }
+	void StoreCStringCopy(const char * pString, const size_t stringLen);
+	void ReleaseCString();
+	void CancelLazyValue();
+	void ResolveLazyValue() const;
+
+	// Mutable so the first const Get*() can resolve a lazy value
+	mutable union {
 		int	  m_AsInt;
 		float m_AsFloat;
 		bool  m_AsBool;
 		const char * m_AsCString;
-	} m_Data;			// 8 bytes for char * ptr.  Use memset to be safe.
+		char  m_AsInlineCString[ms_InlineCStringCapacity];
+	} m_Data;			// 24 bytes so short strings need no heap block.  Use memset to be safe.
 	int8_t m_Type;		// CommandArgType::Type
-	uint8_t m_Flags;	// CommandArgVariableFlags::Flags
+	mutable uint8_t m_Flags;	// CommandArgVariableFlags::Flags
+	mutable std::atomic<uint8_t> m_LazyState;	// CommandArgValueLazyState::State
+};
+
+/// Tagged variant class used for command line variables
+/// Might own the cstring if OwnsCString flag is set
+/// Meant for static memory - will register the command on construction
+/// Deleting a variable removes it from GetInstance() and its child registries, the same as the
+/// registration it must not happen while other threads use those registries
+/// The value itself is stored by CommandArgsMgr::GetInstance(), the variable only points at it
+/// so lookups by key never have to touch the variable
+/// The variable is a shared definition: registries created with a parent keep their 
+/// own values for it and never write to the variable itself
+/// Setting a different value marks the variable dirty in the registry that owns it, 
+/// see CommandArgsMgr::SubscribeToChanges()
+class CommandArgVariable {
+public:
+
+	CommandArgVariable() = delete;
+	CommandArgVariable(const char * pVariableName, const CommandArgVariableType::Type nType, const int defaultIntValue, const uint8_t flags = 0);
+	CommandArgVariable(const char * pVariableName, const CommandArgVariableType::Type nType, const bool defaultBoolValue, const uint8_t flags = 0);
+	CommandArgVariable(const char * pVariableName, const CommandArgVariableType::Type nType, const float defaultFloatValue, const uint8_t flags = 0);
+	CommandArgVariable(const char * pVariableName, const CommandArgVariableType::Type nType, const char * defaultCStringValue, const uint8_t flags = 0);
+	CommandArgVariable(const uint32_t variableHash, const CommandArgVariableType::Type nType, const int defaultIntValue, const uint8_t flags = 0);
+	CommandArgVariable(const uint32_t variableHash, const CommandArgVariableType::Type nType, const bool defaultBoolValue, const uint8_t flags = 0);
+	CommandArgVariable(const uint32_t variableHash, const CommandArgVariableType::Type nType, const float defaultFloatValue, const uint8_t flags = 0);
+	CommandArgVariable(const uint32_t variableHash, const CommandArgVariableType::Type nType, const char * defaultCStringValue, const uint8_t flags = 0);
+	~CommandArgVariable();
+	CommandArgVariable(const CommandArgVariable &) = delete;
+	CommandArgVariable & operator=(const CommandArgVariable &) = delete;
+
+	int GetInt() const { return m_pValue->GetInt(); }
+	float GetFloat() const { return m_pValue->GetFloat(); }
+	bool GetBool() const { return m_pValue->GetBool(); }
+	const char * GetCString() const { return m_pValue->GetCString(); }
+	void SetInt(const int i);
+	void SetFloat(const float f);
+	void SetBool(const bool b);
+	void SetCString(const char * pString);
+	void SetValue(CommandArgValue && rValue);
+	const CommandArgValue & GetValue() const { return *m_pValue; }
+	CommandArgVariableType::Type GetType() const { return m_pValue->GetType(); }
+	void SetFlags(const uint8_t flags) { m_pValue->SetFlags(flags); }
+	uint8_t GetFlags() const { return m_pValue->GetFlags(); }
+	uint32_t GetIndex() const { return m_Index; }
+
+	static const uint32_t ms_InvalidIndex = 0xffffffff;
+
+private:
+	friend class CommandArgsMgr;
+	void MarkDirty();
+
+	CommandArgValue * m_pValue;		// See CommandArgsMgr::PackVariableValues()
+	CommandArgsMgr * m_pOwnerMgr;	// Registry the variable was first registered with
+	uint32_t m_Index;				// Registration order, used as the bit in the dirty bitsets
+	uint32_t m_Key;					// Key it was registered under in m_pOwnerMgr
 };
 
 #define VALIDATE_HASH_COMMAND ( 0 )
@@ -74,6 +163,21 @@ private:
 // calls m_pInputString is still unmodified
 #define COMMANDS_ARGS_PARSER_MAKES_COPY_OF_INPUT_STRING (0)
 
+/// Bitmasks for one 64 byte block of a command, bit N is set if the Nth character is of that class
+struct CommandArgsTokenBlockMasks {
+	uint64_t m_Delimeters;
+	uint64_t m_Terminators;
+	uint64_t m_DoubleQuotes;
+	uint64_t m_SingleQuotes;
+	uint64_t m_Backslashes;
+};
+
+/// Tokenizes the arguments of a command in place
+/// Tokens can be quoted with "" or '' to keep delimiters, a backslash escapes the next character
+/// A token starting with # or // begins a comment and ends the arguments
+/// Plain tokens are found with a scalar scan, as soon as a token holds a quote or backslash its
+/// boundaries are found 64 bytes at a time with delimiter/quote/escape bitmasks so quoted input 
+/// never goes through the character by character unquoting either
 class CommandArgsParser {
 public:
 	static const char * ms_DefaultDelimeters;
@@ -81,11 +185,15 @@ public:
 	static bool Parse_Bool(const char * pString, bool & rInOutBool);
 	static bool Parse_Integer(const char * pString, int & rInOutInt);
 	static bool Parse_Float(const char * pString, float & rInOutFloat);
+	static bool IsCommentStart(const char * pString) { return pString[0] == '#' || (pString[0] == '/' && pString[1] == '/'); }
+	static size_t UnquoteArgs(const char * pString, char * pOutBuffer, const size_t bufferSize, const bool bFirstTokenOnly, const char * pDelimeters = ms_DefaultDelimeters);
 
 	CommandArgsParser();
 	~CommandArgsParser();
 	char * GetInputString() const { return m_pInputString; }
 	char * GetCurrentToken() const { return m_pCurrentToken; }
+	CommandArgsMgr * GetCommandArgsMgr() const { return m_pCommandArgsMgr; }
+	void SetCommandArgsMgr(CommandArgsMgr * pMgr) { m_pCommandArgsMgr = pMgr; }
 	void InitWithArgs(char * pFullString);
 	char * IncrementToken(const char * pDelimeters = ms_DefaultDelimeters);
 	bool CompareToken(const char * pCurToken, const char * pToCompareTo) const;
@@ -96,15 +204,24 @@ public:
 	void Reset();
 
 private:
+	void LoadTokenBlockMasks(const char * pPosition, const char * pDelimeters, CommandArgsTokenBlockMasks & rOutMasks, uint32_t & rOutNumValidBits);
+	char * FindTokenEnd(char * pTokenStart, const char * pDelimeters, bool & rbOutNeedsUnquote);
+	size_t UnquoteTokenWithMasks(char * pTokenStart, char * pTokenEnd, const char * pDelimeters);
 
 	char * m_pInputString;
 	char * m_pInputStringTokenize;
+	char * m_pInputStringEnd;	// Terminating null of m_pInputStringTokenize, blocks never read past it.  nullptr until a block is needed
 	char * m_pCurrentToken;
 	char * m_pNextToken;
+	CommandArgsTokenBlockMasks m_BlockMasks;	// Masks of the last classified block, most tokens are much shorter than a block
+	const char * m_pBlockMasksStart;
+	const char * m_pBlockMasksDelimeters;
+	CommandArgsMgr * m_pCommandArgsMgr;	// Registry that invoked the command
 	bool   m_bHasProcessedFirstToken;
 };
 
 typedef int(*ConsoleCommandFunc)(CommandArgsParser & args);
+typedef void(*CommandArgChangeFunc)(CommandArgsMgr & rMgr, const uint32_t key, void * pUserData);
 
 /// Helper class that allows REGISTER_CONSOLE_COMMAND_FUNCTION to effectively be called 
 /// as part of the CONSOLE_COMMAND_FUNCTION macro
@@ -152,12 +269,61 @@ private:
 	uint8_t m_Type;  // CommandArgEntryType::Type
 };
 
-/// Singleton interface for command arg functions and variables
+namespace CommandArgGetStatus {
+	enum Type {
+		Found,
+		NotFound,
+		TypeMismatch
+	};
+}
+
+/// One value returned by CommandArgsMgr::GetMany(), read the member matching the requested type
+/// Keys that aren't found hold the same defaults as the single key getters
+union CommandArgGetResult {
+	int	  m_AsInt;
+	float m_AsFloat;
+	bool  m_AsBool;
+	const char * m_AsCString;
+};
+
+/// One line of an args file, split into its key and args when the file is loaded
+struct CommandArgsFileCommand {
+	const char * m_pArgs;	// Rest of the line after the name, points into CommandArgsFile::m_pContents
+	uint32_t m_Key;
+	bool m_bExpectsFlag;
+	bool m_bIsInclude;		// exec/include directive, m_pArgs is the path of the file to run
+};
+
+/// Args file split into commands once and shared by every registry that executes the same text
+struct CommandArgsFile {
+	std::unique_ptr<char[]> m_pContents;	// Lines are null terminated in place, the cache compares these terminated contents
+	size_t m_ContentsSize;
+	uint64_t m_ContentsHash;
+	std::vector<CommandArgsFileCommand> m_Commands;
+};
+
+/// Registry of command arg functions and variables
+/// GetInstance() is the shared base table every static variable/function registers with
+/// Additional registries can be created with a parent to get independent values per 
+/// tenant/subsystem/test: lookups check the local registry first and then walk the parent chain
+/// Setting a variable defined in a parent stores the value in the local registry, so the 
+/// shared definition and sibling registries are left untouched
+/// Value changes are not broadcast immediately: they set a bit in the registry's dirty bitset 
+/// and DispatchChanges() notifies each subscription once, no matter how often the value changed
+/// Subscribers in a child also hear about changes made in its parents: every change stamps the variable
+/// with a process wide epoch and the child's DispatchChanges() compares the newest stamp along its parent
+/// chain against the last one it dispatched.  Children only read their parents, so registries on different
+/// threads need no locking as long as their parents aren't changed meanwhile.  Parents must outlive their children
 /// Initialize with SetupAllCommandArgs()
 /// Invoke with Execute()
 class CommandArgsMgr {
 public:
 
+	explicit CommandArgsMgr(CommandArgsMgr * pParent = nullptr);
+	~CommandArgsMgr();
+	CommandArgsMgr(const CommandArgsMgr &) = delete;
+	CommandArgsMgr & operator=(const CommandArgsMgr &) = delete;
+
 	static CommandArgsMgr & GetInstance() { return ms_Instance; }
 	static uint32_t HashCommandLineArg(const char * pString);
 	static uint32_t HashCommandLineArg_StartEnd(const char * pStart, const char * pEnd);
@@ -165,6 +331,7 @@ public:
 	static char * FindFirstNonWhitespaceCharacter(const char * pString, const char * pWhitespaceCharacters = CommandArgsParser::ms_DefaultDelimeters);
 	static char * FindFirstWhitespaceCharacterAfterFirstToken(const char * pString, const char * pWhitespaceCharacters = CommandArgsParser::ms_DefaultDelimeters);
 
+	CommandArgsMgr * GetParent() const { return m_pParent; }
 	void RegisterCommandArgVariableByName(const char * pArgName, CommandArgVariable * ptr);
 	void RegisterCommandArgVariableByHash(const uint32_t argHashValue, CommandArgVariable * ptr);
 	void RegisterCommandArgFunctionByName(const char * pArgName, const ConsoleCommandFunc pFunc);
@@ -174,15 +341,162 @@ public:
 	float GetFloatForKey(const uint32_t key);
 	bool GetBoolForKey(const uint32_t key);
 	const char * GetCStringForKey(const uint32_t key);
+	/// Looks up a batch of keys before reading any of their values so the cache misses overlap
+	/// pOutStatuses gets a CommandArgGetStatus::Type per key, returns the number found with the expected type
+	uint32_t GetMany(const uint32_t * pKeys, const CommandArgVariableType::Type * pTypes, const size_t numKeys, CommandArgGetResult * pOutResults, uint8_t * pOutStatuses);
+	void ClearLocalValues();
+	uint32_t SubscribeToChanges(const uint32_t key, const CommandArgChangeFunc pFunc, void * pUserData = nullptr);
+	void UnsubscribeFromChanges(const uint32_t subscriptionHandle);
+	void MarkVariableDirty(const uint32_t variableIndex);
+	uint32_t DispatchChanges();
+	void SetEnvironmentPrefix(const char * pPrefix) { m_pEnvironmentPrefix = pPrefix; }
+	const char * GetEnvironmentPrefix() const { return m_pEnvironmentPrefix; }
+	/// When enabled, variables set by args files keep their text in a buffer retained by the registry
+	/// and only parse it on the first Get*() so startup cost scales with the variables actually read
+	/// A buffer is released after a load or ClearLocalValues() once none of its values is pending anymore
+	void SetLazyValueParsing(const bool bLazy) { m_bLazyValueParsing = bLazy; }
+	bool GetLazyValueParsing() const { return m_bLazyValueParsing; }
+	/// Moves the values stored by this registry into one cache line aligned array, 
+	/// hot keys first and the rest in registration order.  Variables store their values in GetInstance()
+	/// Call after static initialization, after children registered their own variables 
+	/// and before other threads read any variable
+	void PackVariableValues(const uint32_t * pHotKeys = nullptr, const size_t numHotKeys = 0);
+	/// Loaded args files are cached by content for the whole process, so an unchanged file
+	/// is only split into commands once no matter how many registries or reloads execute it
+	/// Only the most recently used files are kept, registries using lazy values keep their own files alive
+	static void ClearArgsFileCache();
+
+	/// Executes commands from every source from lowest to highest precedence:
+	/// 1. Args files, any argument not starting with + or --
+	///    A line "exec path" or "include path" runs another args file in place, relative paths 
+	///    start from the including file's directory and include cycles are skipped
+	/// 2. Environment variables starting with the environment prefix, e.g. CMDARGS_g_TestFloat=2.5
+	/// 3. Command line pairs, +name value or --name=value, a name on its own is a flag
+	///    +name only takes the next argument of a bool variable if it's true, false or a number
 	void SetupAllCommandArgs(const int argc, char * argv[]);
 	int Execute(const char * pCommand);
 
 private:
-	bool FindCommandArgEntry(std::unordered_map<uint32_t, CommandArgEntry>::iterator & inOutIterator, const uint32_t key);
+	friend class CommandArgsScriptExecutor;
+	friend class CommandArgVariable;
+
+	const CommandArgEntry * FindCommandArgEntry(const uint32_t key) const;
+	const CommandArgValue * FindValueForKey(const uint32_t key) const;
+	void MarkKeyDirty(const uint32_t key);
+	static uint32_t SplitCommand(const char * pCommand, char *& rpOutArgs, bool & rbOutExpectsFlag);
+	int ExecuteInternal(const char * pCommand, const bool bDeferVariables);
+	int ExecuteSplitCommand(const uint32_t key, char * pArgRHSString, const bool bExpectsFlag, const bool bDeferVariables, const bool bArgsAreShared);
+	bool ExecuteArgsFile(const std::string & rFileName, std::vector<std::string> & rIncludeStack);
+	void ReleaseUnusedArgsFiles();
+	static std::shared_ptr<const CommandArgsFile> LoadArgsFile(const char * pFileName);
+	static std::shared_ptr<const CommandArgsFile> LoadArgsString(const char * pContents);
+	static std::shared_ptr<const CommandArgsFile> SplitArgsFile(const std::shared_ptr<CommandArgsFile> & pArgsFile, const bool bUseCache);
+
+	/// Open addressing copy of m_CommandArgsMap so GetMany() can prefetch a probe before making it
+	/// Points straight at the variable values so a lookup only touches the slot and the value
+	struct LookupSlot {
+		uint32_t m_Key;
+		uint32_t m_bUsed;
+		const CommandArgValue * m_pValue;	// nullptr for functions
+	};
+	size_t GetLookupSlotIndex(const uint32_t key) const { return static_cast<uint32_t>(key * 0x9E3779B1u) >> m_LookupSlotShift; }
+	const LookupSlot * FindLookupSlot(const uint32_t key) const;
+	void AddLookupSlot(const uint32_t key, const CommandArgValue * pValue);
+	void RemoveLookupSlot(const uint32_t key);
+	void RebuildLookupSlots();
+
+	/// Cache line aligned storage for the values of variables constructed in static memory
+	struct VariableValueBlock {
+		CommandArgValue * m_pValues;
+		void * m_pAllocation;	// Unaligned block m_pValues was placed in
+		size_t m_NumValues;
+		size_t m_Capacity;
+	};
+	CommandArgValue * AllocateVariableValue(CommandArgVariable * pVariable, const CommandArgVariableType::Type nType, const uint8_t flags);
+	void ReleaseVariableValues();
+	void UnregisterVariable(CommandArgVariable * pVariable);
+	uint64_t GetInheritedChangeEpoch(const uint32_t variableIndex) const;
+	void AppendEnvironmentCommands(std::vector<std::string> & rOutCommands) const;
+	bool CommandLineArgTakesValue(const int argc, char * argv[], const int nameIndex) const;
+	void AppendCommandLineCommands(const int argc, char * argv[], std::vector<std::string> & rOutCommands) const;
+
+	struct ChangeSubscription {
+		uint32_t m_Handle;
+		uint32_t m_Key;
+		CommandArgChangeFunc m_pFunc;	// nullptr once unsubscribed, removed after the next dispatch
+		void * m_pUserData;
+	};
 
 	std::unordered_map<uint32_t, CommandArgEntry> m_CommandArgsMap;
+	std::unordered_map<uint32_t, CommandArgValue> m_LocalValues;	// Values for variables defined in a parent registry
+	std::vector<std::vector<ChangeSubscription>> m_ChangeSubscriptions;	// Indexed by CommandArgVariable::GetIndex()
+	std::vector<uint64_t> m_DirtyBits;	// One bit per CommandArgVariable::GetIndex()
+	std::vector<uint64_t> m_LocalValueBits;	// Same layout, set for variables with an entry in m_LocalValues
+	std::vector<uint64_t> m_ChangeEpochs;	// ms_ChangeEpoch of the last change per CommandArgVariable::GetIndex()
+	std::vector<uint64_t> m_SeenInheritedEpochs;	// Newest parent change already dispatched, same indexing
+	std::vector<uint32_t> m_SubscribedVariables;	// Indices with a non empty m_ChangeSubscriptions list
+	std::vector<CommandArgsMgr *> m_Children;	// Registries created with this one as their parent, guarded by ms_ChildRegistriesMutex
+	std::vector<std::shared_ptr<const CommandArgsFile>> m_RetainedArgsFiles;	// Lazy values point into these, dropped once none does
+	std::vector<LookupSlot> m_LookupSlots;	// Power of two sized, at most half full
+	uint32_t m_LookupSlotShift;
+	std::vector<VariableValueBlock> m_ValueBlocks;
+	std::vector<CommandArgVariable *> m_StoredVariables;	// Variable of every stored value in storage order
+	CommandArgsMgr * m_pParent;
+	const char * m_pEnvironmentPrefix;	// nullptr ignores the environment
+	uint64_t m_LastDispatchEpoch;	// ms_ChangeEpoch when inherited changes were last checked
+	uint32_t m_NextSubscriptionHandle;
+	bool m_bIsDispatching;
+	bool m_bHasUnsubscribedWhileDispatching;	// Cleared subscriptions left in m_ChangeSubscriptions
+	bool m_bLazyValueParsing;
 
+	static uint32_t ms_NumRegisteredVariables;
+	static const size_t ms_MaxArgsFileIncludeDepth = 16;	// Backstop for cycles through differently spelled paths
+	static const size_t ms_ValueBlockCapacity = 64;
+	static const size_t ms_MaxCachedArgsFiles = 16;
+	static std::vector<std::shared_ptr<const CommandArgsFile>> ms_ArgsFileCache;	// Most recently used last
+	static std::mutex ms_ArgsFileCacheMutex;
+	static std::atomic<uint64_t> ms_ChangeEpoch;
+	static std::mutex ms_ChildRegistriesMutex;	// Only taken when registries are created, destroyed or packed
 	static CommandArgsMgr ms_Instance;
 };
 
+namespace CommandArgsScriptState {
+	enum Type {
+		Finished,	// Nothing loaded or every command has run
+		Running,	// Stopped by the Tick() budget, more commands are ready
+		Waiting		// Paused by wait or wait_ms
+	};
+}
+
+/// Runs an args file a slice at a time from the main loop instead of all at once
+/// Besides everything an args file can hold a script can pause itself:
+/// wait <frames>	skips the next <frames> Tick() calls, 1 when no count is given
+/// wait_ms <n>		resumes on the first Tick() at least n milliseconds later
+class CommandArgsScriptExecutor {
+public:
+
+	explicit CommandArgsScriptExecutor(CommandArgsMgr & rMgr);
+	bool LoadFile(const char * pFileName);
+	bool LoadString(const char * pScript);
+	void Stop();
+	/// Runs commands until the script waits, finishes or hits a limit, 0 means no limit
+	/// At least one command runs per call so the script always makes progress
+	CommandArgsScriptState::Type Tick(const uint32_t maxCommands, const uint32_t maxMicroseconds = 0);
+	CommandArgsScriptState::Type GetState() const;
+
+private:
+	bool PushScript(const std::shared_ptr<const CommandArgsFile> & pScript, const std::string & rFileName);
+
+	struct ScriptFrame {
+		std::shared_ptr<const CommandArgsFile> m_pScript;
+		std::string m_FileName;		// Empty for scripts loaded from a string
+		size_t m_NextCommand;
+	};
+
+	CommandArgsMgr * m_pMgr;
+	std::vector<ScriptFrame> m_Frames;	// The innermost exec is last
+	int64_t m_WaitUntilMicroseconds;
+	uint32_t m_FramesToWait;
+};
+
 #endif // COMMAND_ARGS_PARSER_H
\ No newline at end of file
@@ -36,7 +36,291 @@ int main(int argc, char * argv[]) {
 	LogHashCommandFunctionMacro(pString);
 	return 0;
 }
+#elif _BENCHMARK_GET_MANY
+// This pre-processor define builds a benchmark comparing GetMany() against 
+// looping over the single key getters for the same keys
+// Caches are flushed before every read since tunables are usually read once per frame or system update
+#include <chrono>
+#include <vector>
+#include <string>
+#include <random>
+#include <cstdlib>
+
+typedef std::chrono::high_resolution_clock BenchmarkClock;
+
+static std::vector<char> s_CacheFlushBuffer(32 * 1024 * 1024);
+
+static void FlushCaches() {
+	for (size_t i = 0; i < s_CacheFlushBuffer.size(); i += 64) {
+		++s_CacheFlushBuffer[i];
+	}
+}
+
+int main(int argc, char * argv[]) {
+	const int numVariables = (argc > 1) ? atoi(argv[1]) : 4096;
+	const size_t keysPerRead = (argc > 2) ? static_cast<size_t>(atoi(argv[2])) : 64;
+	const int numIterations = (argc > 3) ? atoi(argv[3]) : 200;
+	// Variables are allocated between unrelated blocks so they end up scattered like real statics
+	std::vector<CommandArgVariable *> variables;
+	std::vector<char *> fillerBlocks;
+	std::vector<uint32_t> allKeys;
+	for (int i = 0; i < numVariables; ++i) {
+		const std::string name = "g_BenchVariable" + std::to_string(i);
+		const uint32_t key = CommandArgsMgr::HashCommandLineArg(name.c_str());
+		fillerBlocks.push_back(new char[64 + (i % 7) * 32]);
+		if (i % 2 == 0) {
+			variables.push_back(new CommandArgVariable(key, CommandArgVariableType::Integer, i));
+		} else {
+			variables.push_back(new CommandArgVariable(key, CommandArgVariableType::Float, static_cast<float>(i)));
+		}
+		allKeys.push_back(key);
+	}
+	std::vector<uint32_t> keys(keysPerRead);
+	std::vector<CommandArgVariableType::Type> types(keysPerRead);
+	std::vector<CommandArgGetResult> results(keysPerRead);
+	std::vector<uint8_t> statuses(keysPerRead);
+	std::mt19937 rng(1234);
+	CommandArgsMgr & rMgr = CommandArgsMgr::GetInstance();
+
+	double loopNanoseconds = 0.0;
+	double manyNanoseconds = 0.0;
+	float loopChecksum = 0.0f;
+	float manyChecksum = 0.0f;
+	for (int iteration = 0; iteration < numIterations; ++iteration) {
+		for (size_t i = 0; i < keysPerRead; ++i) {
+			const size_t variableIndex = rng() % allKeys.size();
+			keys[i] = allKeys[variableIndex];
+			types[i] = (variableIndex % 2 == 0) ? CommandArgVariableType::Integer : CommandArgVariableType::Float;
+		}
+
+		FlushCaches();
+		const BenchmarkClock::time_point loopStart = BenchmarkClock::now();
+		for (size_t i = 0; i < keysPerRead; ++i) {
+			if (types[i] == CommandArgVariableType::Integer) {
+				loopChecksum += static_cast<float>(rMgr.GetIntegerForKey(keys[i]));
+			} else {
+				loopChecksum += rMgr.GetFloatForKey(keys[i]);
+			}
+		}
+		loopNanoseconds += std::chrono::duration<double, std::nano>(BenchmarkClock::now() - loopStart).count();
+
+		FlushCaches();
+		const BenchmarkClock::time_point manyStart = BenchmarkClock::now();
+		rMgr.GetMany(keys.data(), types.data(), keysPerRead, results.data(), statuses.data());
+		for (size_t i = 0; i < keysPerRead; ++i) {
+			manyChecksum += (types[i] == CommandArgVariableType::Integer) ? static_cast<float>(results[i].m_AsInt) : results[i].m_AsFloat;
+		}
+		manyNanoseconds += std::chrono::duration<double, std::nano>(BenchmarkClock::now() - manyStart).count();
+	}
+
+	const double numReads = static_cast<double>(numIterations) * static_cast<double>(keysPerRead);
+	std::cout << numVariables << " variables, " << keysPerRead << " keys per read" << std::endl;
+	std::cout << "Single key getters: " << loopNanoseconds / numReads << " ns per key" << std::endl;
+	std::cout << "GetMany:            " << manyNanoseconds / numReads << " ns per key" << std::endl;
+	std::cout << "Checksums " << loopChecksum << " " << manyChecksum << std::endl;
+
+	for (size_t i = 0; i < variables.size(); ++i) {
+		delete variables[i];
+		delete[] fillerBlocks[i];
+	}
+	return 0;
+}
+#elif _BENCHMARK_TOKENIZER
+// This pre-processor define builds a benchmark comparing IncrementToken() against strtok_s
+// on the same lines, quoting support shouldn't make plain arguments any slower to tokenize
+#include <chrono>
+#include <vector>
+#include <string>
+#include <cstdlib>
+
+typedef std::chrono::high_resolution_clock BenchmarkClock;
+
+int main(int argc, char * argv[]) {
+	const int numIterations = (argc > 1) ? atoi(argv[1]) : 1000000;
+	std::string longLine;
+	for (int i = 0; i < 3; ++i) {
+		longLine += "-pos 3.0 4.0 5.0 -a -file output.txt ";
+	}
+	const std::string lines[] = { "1 2 3", "3.0 6.0 -1.0", longLine, "-pos 3.0 4.0 5.0 -a -file \"my output.txt\"" };
+	for (size_t l = 0; l < sizeof(lines) / sizeof(lines[0]); ++l) {
+		// Both tokenize in place so each run starts from a fresh copy of the line
+		const std::string & rLine = lines[l];
+		std::vector<char> buffer(rLine.size() + 1);
+		size_t numParserTokens = 0;
+		size_t numStrtokTokens = 0;
+
+		const BenchmarkClock::time_point parserStart = BenchmarkClock::now();
+		for (int iteration = 0; iteration < numIterations; ++iteration) {
+			memcpy(buffer.data(), rLine.c_str(), buffer.size());
+			CommandArgsParser parser;
+			parser.InitWithArgs(buffer.data());
+			while (parser.IncrementToken()) {
+				++numParserTokens;
+			}
+		}
+		const double parserNanoseconds = std::chrono::duration<double, std::nano>(BenchmarkClock::now() - parserStart).count();
+
+		const BenchmarkClock::time_point strtokStart = BenchmarkClock::now();
+		for (int iteration = 0; iteration < numIterations; ++iteration) {
+			memcpy(buffer.data(), rLine.c_str(), buffer.size());
+			char * pContext = nullptr;
+			for (char * pToken = strtok_s(buffer.data(), CommandArgsParser::ms_DefaultDelimeters, &pContext); pToken; pToken = strtok_s(nullptr, CommandArgsParser::ms_DefaultDelimeters, &pContext)) {
+				++numStrtokTokens;
+			}
+		}
+		const double strtokNanoseconds = std::chrono::duration<double, std::nano>(BenchmarkClock::now() - strtokStart).count();
+
+		std::cout << "\"" << rLine << "\" (" << rLine.size() << " bytes)" << std::endl;
+		std::cout << "IncrementToken: " << parserNanoseconds / numIterations << " ns per line, " << numParserTokens / numIterations << " tokens" << std::endl;
+		std::cout << "strtok_s:       " << strtokNanoseconds / numIterations << " ns per line, " << numStrtokTokens / numIterations << " tokens" << std::endl;
+	}
+	return 0;
+}
+#elif _CONSOLE_SERVER_LOAD_TEST
+// This pre-processor define builds a load test for CommandArgsConsoleServer
+// Client threads connect over the Unix domain socket and keep a window of commands in flight
+// while the main thread owns the server, reporting commands per second and round trip latency
+#include "CommandArgsConsoleServer.h"
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <algorithm>
+#include <cstdlib>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+CommandArgVariable g_LoadTestValue("g_LoadTestValue", CommandArgVariableType::Integer, 0);
+static int s_LoadTestSum = 0;
+
+CONSOLE_COMMAND_FUNCTION_NAME(LoadTestAdd)(CommandArgsParser & args) {
+	int value = 0;
+	if (!args.IncrementTokenAndParseInt(value)) {
+		return 0;
+	}
+	s_LoadTestSum += value;
+	return 1;
+}
+
+typedef std::chrono::steady_clock LoadTestClock;
+
+struct LoadTestClientResult {
+	std::vector<double> m_LatenciesMicroseconds;	// One per window
+	uint32_t m_NumFailed;
+	bool m_bConnected;
+};
+
+static void RunLoadTestClient(const char * pSocketPath, const int clientIndex, const int numCommands, const int windowSize, LoadTestClientResult & rOutResult) {
+	rOutResult.m_NumFailed = 0;
+	rOutResult.m_bConnected = false;
+	const int clientSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, pSocketPath, sizeof(address.sun_path) - 1);
+	if (connect(clientSocket, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0) {
+		close(clientSocket);
+		return;
+	}
+	rOutResult.m_bConnected = true;
+	std::string requests;
+	char replies[4096];
+	for (int commandIndex = 0; commandIndex < numCommands; commandIndex += windowSize) {
+		const int numInWindow = std::min(windowSize, numCommands - commandIndex);
+		requests.clear();
+		for (int i = 0; i < numInWindow; ++i) {
+			requests += ((commandIndex + i) % 2 == 0) ? "g_LoadTestValue " : "LoadTestAdd ";
+			requests += std::to_string(clientIndex);
+			requests += '\n';
+		}
+		const LoadTestClock::time_point windowStart = LoadTestClock::now();
+		for (size_t numSent = 0; numSent < requests.size();) {
+			const ssize_t result = send(clientSocket, requests.data() + numSent, requests.size() - numSent, MSG_NOSIGNAL);
+			if (result <= 0) {
+				close(clientSocket);
+				return;
+			}
+			numSent += static_cast<size_t>(result);
+		}
+		// Every command gets a reply line, 1 for success
+		int numReplies = 0;
+		bool bLineFailed = false;
+		while (numReplies < numInWindow) {
+			const ssize_t numReceived = recv(clientSocket, replies, sizeof(replies), 0);
+			if (numReceived <= 0) {
+				close(clientSocket);
+				return;
+			}
+			for (ssize_t i = 0; i < numReceived; ++i) {
+				if (replies[i] == '\n') {
+					rOutResult.m_NumFailed += bLineFailed ? 1 : 0;
+					bLineFailed = false;
+					++numReplies;
+				} else if (replies[i] != '1') {
+					bLineFailed = true;
+				}
+			}
+		}
+		rOutResult.m_LatenciesMicroseconds.push_back(std::chrono::duration<double, std::micro>(LoadTestClock::now() - windowStart).count());
+	}
+	close(clientSocket);
+}
+
+int main(int argc, char * argv[]) {
+	const int numClients = (argc > 1) ? atoi(argv[1]) : 8;
+	const int numCommandsPerClient = (argc > 2) ? atoi(argv[2]) : 100000;
+	const int windowSize = (argc > 3) ? std::max(1, atoi(argv[3])) : 32;
+	const std::string socketPath = "/tmp/command_args_console_" + std::to_string(getpid()) + ".sock";
+
+	CommandArgsConsoleServer server(CommandArgsMgr::GetInstance());
+	if (!server.Start(socketPath.c_str(), static_cast<uint32_t>(numClients))) {
+		std::cerr << "Failed to start the console server on " << socketPath << std::endl;
+		return 1;
+	}
+	std::vector<LoadTestClientResult> results(numClients);
+	std::vector<std::thread> clients;
+	std::atomic<int> numClientsDone(0);
+	const LoadTestClock::time_point testStart = LoadTestClock::now();
+	for (int c = 0; c < numClients; ++c) {
+		clients.push_back(std::thread([&, c]() {
+			RunLoadTestClient(socketPath.c_str(), c, numCommandsPerClient, windowSize, results[c]);
+			++numClientsDone;
+		}));
+	}
+	// The server only ever runs on this thread, like it would inside a game or service main loop
+	uint64_t numExecuted = 0;
+	while (numClientsDone.load() < numClients || server.GetNumClients() > 0) {
+		numExecuted += server.Poll(0, 1);
+	}
+	const double testSeconds = std::chrono::duration<double>(LoadTestClock::now() - testStart).count();
+	for (size_t c = 0; c < clients.size(); ++c) {
+		clients[c].join();
+	}
+	server.Stop();
+
+	std::vector<double> latencies;
+	uint32_t numFailed = 0;
+	int numConnected = 0;
+	for (size_t c = 0; c < results.size(); ++c) {
+		latencies.insert(latencies.end(), results[c].m_LatenciesMicroseconds.begin(), results[c].m_LatenciesMicroseconds.end());
+		numFailed += results[c].m_NumFailed;
+		numConnected += results[c].m_bConnected ? 1 : 0;
+	}
+	std::sort(latencies.begin(), latencies.end());
+	std::cout << numConnected << "/" << numClients << " clients, " << numCommandsPerClient << " commands each, " << windowSize << " in flight per client" << std::endl;
+	std::cout << "Executed " << numExecuted << " commands in " << testSeconds << " s, " << static_cast<uint64_t>(numExecuted / testSeconds) << " commands/s, " << numFailed << " failed" << std::endl;
+	if (!latencies.empty()) {
+		std::cout << "Round trip per window: p50 " << latencies[latencies.size() / 2] << " us, p99 " << latencies[latencies.size() * 99 / 100] <<
+			" us, max " << latencies.back() << " us" << std::endl;
+	}
+	return (numFailed == 0 && numConnected == numClients) ? 0 : 1;
+}
 #else
+#include <thread>
+#include <chrono>
+
 // These are the actual variables users can create easily in static memory
 // Then they just need to use the GetX() function on it and they're done!
 CommandArgVariable g_TestInteger(HASH_COMMAND_VARIABLE("g_testInteger", 0xf681f79d), CommandArgVariableType::Integer, 0);
@@ -61,7 +345,7 @@ CONSOLE_COMMAND_FUNCTION_HASH(SetPlayerPosition, 0x13748f32)(CommandArgsParser &
 // a vector3, a flag, and a c-string output file
 CONSOLE_COMMAND_FUNCTION_NAME(SetPerformanceTestPosition)(CommandArgsParser & args) {
 	// If COMMANDS_ARGS_PARSER_MAKES_COPY_OF_INPUT_STRING is disabled we have to do this before incrementing any tokens
-	// Unfortunately strtok_s modifies the original string for us
+	// Unfortunately IncrementToken modifies the original string for us
 	std::cout << "SetPerformanceTestPosition Command Invoked pArgs = " << args.GetInputString() << std::endl;
 	bool bSomeFlag = false;
 	float fx = 0.0f, fy = 0.0f, fz = 0.0f;
@@ -89,13 +373,26 @@ void PrintCurrentCommandVariables() {
 	std::cout << "g_UserStringPrefix = " << g_UserStringPrefix.GetCString() << std::endl;
 }
 
+// Invoked from DispatchChanges() at most once per dispatch, however often the value was set
+void OnTestFloatChanged(CommandArgsMgr & rMgr, const uint32_t key, void * /*pUserData*/) {
+	std::cout << "g_TestFloat changed to " << rMgr.GetFloatForKey(key) << std::endl;
+}
+
 int main(int argc, char * argv[]) {
 
+	CommandArgsMgr::GetInstance().SubscribeToChanges(CommandArgsMgr::HashCommandLineArg("g_TestFloat"), &OnTestFloatChanged);
+
 	std::cout << "Print Command Variables Before Args File..." << std::endl;
 	PrintCurrentCommandVariables();
 
 	std::cout << "SetupAllCommandArgs..." << std::endl;
+	// e.g. CMDARGS_g_TestInteger=5 ./app command_line_args.txt +g_TestFloat 4.5 --g_UserStringPrefix="guest user"
+	CommandArgsMgr::GetInstance().SetEnvironmentPrefix("CMDARGS_");
+	// Variables read every frame share the first cache lines
+	const uint32_t hotKeys[] = { CommandArgsMgr::HashCommandLineArg("g_TestFloat"), CommandArgsMgr::HashCommandLineArg("g_EnableExtraLogging") };
+	CommandArgsMgr::GetInstance().PackVariableValues(hotKeys, sizeof(hotKeys) / sizeof(hotKeys[0]));
 	CommandArgsMgr::GetInstance().SetupAllCommandArgs(argc, argv);
+	CommandArgsMgr::GetInstance().DispatchChanges();
 
 	std::cout << "Print Command Variables After Args File..." << std::endl;
 	PrintCurrentCommandVariables();
@@ -103,6 +400,25 @@ int main(int argc, char * argv[]) {
 	char buffer[256];
 	snprintf(buffer, 256, "SetPlayerPosition %.3f %.3f %.3f", 2.0f, 5.0f, 7.0f);
 	CommandArgsMgr::GetInstance().Execute(buffer);
+
+	// Registries created with a parent keep their own values and leave the shared variables alone
+	CommandArgsMgr sessionArgs(&CommandArgsMgr::GetInstance());
+	sessionArgs.SubscribeToChanges(CommandArgsMgr::HashCommandLineArg("g_TestFloat"), &OnTestFloatChanged);
+	sessionArgs.Execute("g_TestFloat 9.0");
+	sessionArgs.Execute("g_TestFloat 9.25");
+	sessionArgs.DispatchChanges();
+	std::cout << "Session g_TestFloat = " << sessionArgs.GetFloatForKey(CommandArgsMgr::HashCommandLineArg("g_TestFloat")) <<
+		" Global g_TestFloat = " << g_TestFloat.GetFloat() << std::endl;
+
+	// Scripts run a few commands per frame instead of stalling the frame that started them
+	CommandArgsScriptExecutor scriptExecutor(CommandArgsMgr::GetInstance());
+	scriptExecutor.LoadString("g_TestInteger 2\nwait 2\nSetPlayerPosition 1 2 3\nwait_ms 5\ng_TestInteger 3");
+	int frameIndex = 0;
+	while (scriptExecutor.Tick(4, 1000) != CommandArgsScriptState::Finished) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		++frameIndex;
+	}
+	std::cout << "Script finished after " << frameIndex << " frames g_TestInteger = " << g_TestInteger.GetInt() << std::endl;
 	return 0;
 }
 #endif //
\ No newline at end of file